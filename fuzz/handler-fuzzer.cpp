@@ -0,0 +1,83 @@
+// Fuzzing of path resolution in RequestHandler::handle, with the input as the
+// request uri. A small document root is served next to a file that must never
+// be: through the filesystem by one handler and from a warmed-up index by
+// another, and both have to answer every request the same way.
+
+#include "request.hpp"
+#include "request_handler.hpp"
+#include "response.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using http::Request;
+using http::RequestHandler;
+using http::Response;
+
+namespace {
+
+constexpr std::string_view secret_v = "outside the document root";
+
+void write_file(const fs::path& path, std::string_view content) {
+    std::ofstream{path} << content;
+}
+
+// a document root with nested directories, one without an index, and
+// symlinks that stay inside it or lead out of it. Removed on exit
+struct DocumentRoot {
+    fs::path base = fs::temp_directory_path() /
+                    ("http-fuzz-" + std::to_string(::getpid()));
+    fs::path root = base / "root";
+
+    DocumentRoot() {
+        fs::remove_all(base);
+        fs::create_directories(root / "dir" / "nested");
+        fs::create_directories(root / "empty");
+        write_file(base / "secret.txt", secret_v);
+        write_file(root / "index.html", "<html></html>");
+        write_file(root / "style.css", "body {}");
+        write_file(root / "dir" / "index.html", "<html>dir</html>");
+        write_file(root / "dir" / "nested" / "a b+c.txt", "spaces");
+        fs::create_symlink("index.html", root / "inside.html");
+        fs::create_symlink("../secret.txt", root / "escape.txt");
+        fs::create_symlink("..", root / "up");
+        fs::create_symlink(base / "secret.txt", root / "absolute.txt");
+    }
+
+    ~DocumentRoot() { fs::remove_all(base); }
+};
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size) {
+    static const auto document_root = DocumentRoot{};
+    static auto files = RequestHandler{document_root.root};
+    static auto indexed = RequestHandler{
+        document_root.root, {.enabled = true, .preload_budget = 1 << 20}};
+
+    Request req;
+    req.method = "GET";
+    req.uri.assign(reinterpret_cast<const char*>(data), size);
+
+    const auto from_files = files.handle(req);
+    const auto from_index = indexed.handle(req);
+
+    if (from_files.status == Response::StatusCode::InternalServerError ||
+        from_files.body().contains(secret_v)) {
+        std::abort();
+    }
+
+    if (from_files.status != from_index.status ||
+        from_files.body() != from_index.body()) {
+        std::abort();
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+// Differential fuzzing of RequestParser::parse: the same input is parsed as a
+// whole, a byte at a time and split at random points by a parser that was
+// already used and reset, and every way has to end up with the same result
+// and the same Request.
+
+#include "request.hpp"
+#include "request_parser.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+using http::Request;
+using http::RequestParser;
+
+namespace {
+
+// small enough for inputs to run into it, so TooLarge is exercised too
+constexpr std::size_t small_head_size_v = 64;
+
+// upper bound of a random chunk, a connection reads at least 512 bytes at a
+// time but small chunks cross more state boundaries
+constexpr std::size_t max_chunk_size_v = 32;
+
+// everything parsing leaves behind, in a comparable form
+struct Parsed {
+    RequestParser::Result result;
+    std::string method, uri;
+    int major, minor;
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    bool operator==(const Parsed&) const = default;
+};
+
+// feed input to parser in chunks of next_size() bytes, stopping at the first
+// definite result like a connection does
+template <typename F>
+Parsed parse_in_chunks(RequestParser& parser, std::string_view input,
+                       F&& next_size) {
+    Request req;
+    auto result = RequestParser::Result::Indeterminate;
+    while (!input.empty() && result == RequestParser::Result::Indeterminate) {
+        const auto size = std::min(next_size(), input.size());
+        result = parser.parse(req, input.substr(0, size));
+        input.remove_prefix(size);
+    }
+
+    Parsed parsed{result, req.method, req.uri, req.version.major,
+                  req.version.minor, {}};
+    req.headers.for_each([&parsed](std::string_view name,
+                                   std::string_view value) {
+        parsed.headers.emplace_back(name, value);
+    });
+    return parsed;
+}
+
+void check(std::string_view input, std::size_t max_head_size) {
+    RequestParser whole_parser{max_head_size};
+    const auto whole = parse_in_chunks(whole_parser, input,
+                                       [&input]() { return input.size(); });
+
+    RequestParser byte_parser{max_head_size};
+    const auto bytes =
+        parse_in_chunks(byte_parser, input, []() { return 1uz; });
+
+    // split points are derived from the input so a crash reproduces from it
+    // alone
+    auto random = std::minstd_rand{static_cast<std::uint_fast32_t>(
+        std::hash<std::string_view>{}(input))};
+    auto chunk_size =
+        std::uniform_int_distribution<std::size_t>{1, max_chunk_size_v};
+
+    // connections reuse their parser across requests
+    RequestParser reused_parser{max_head_size};
+    std::ignore = parse_in_chunks(reused_parser, input,
+                                  [&input]() { return input.size(); });
+    reused_parser.reset();
+    const auto split = parse_in_chunks(
+        reused_parser, input, [&]() { return chunk_size(random); });
+
+    if (whole != bytes || whole != split) {
+        std::abort();
+    }
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size) {
+    const auto input =
+        std::string_view{reinterpret_cast<const char*>(data), size};
+    check(input, RequestParser::default_max_head_size_v);
+    check(input, small_head_size_v);
+    return 0;
+}
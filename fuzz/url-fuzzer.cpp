@@ -0,0 +1,59 @@
+// Fuzzing of decode_url: whatever it accepts has to come out as a normalized
+// absolute path, the only kind RequestHandler resolves beneath the document
+// root.
+
+#include "request_handler.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+using http::decode_url;
+
+namespace {
+
+// absolute, without empty, "." or ".." segments and without NUL bytes
+bool is_normalized(std::string_view path) {
+    if (!path.starts_with('/') || path.contains('\0')) {
+        return false;
+    }
+
+    for (auto begin = 1uz; begin < path.size();) {
+        const auto end = std::min(path.find('/', begin), path.size());
+        const auto segment = path.substr(begin, end - begin);
+        if (segment.empty() || segment == "." || segment == "..") {
+            return false;
+        }
+        begin = end + 1;
+    }
+    return true;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size) {
+    const auto uri = std::string_view{reinterpret_cast<const char*>(data), size};
+
+    // handlers reuse the output buffer, so it starts out dirty
+    auto path = std::string{"/stale/../contents"};
+    if (!decode_url(uri, path)) {
+        return 0;
+    }
+
+    if (!is_normalized(path)) {
+        std::abort();
+    }
+
+    // without anything left to decode, a normalized path decodes to itself
+    if (path.find_first_of("%+?") == std::string::npos) {
+        auto again = std::string{};
+        if (!decode_url(path, again) || again != path) {
+            std::abort();
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace http {
+
+// Hands out buffers in power of two size classes and keeps released ones for
+// reuse, so connections only need to hold a read buffer while input is being
+// processed rather than for as long as they stay open.
+class BufferPool {
+  public:
+    constexpr static inline std::size_t min_buffer_size_v = 512;
+    constexpr static inline std::size_t size_classes_v = 8;
+    constexpr static inline std::size_t max_buffer_size_v =
+        min_buffer_size_v << (size_classes_v - 1); // 64 KiB
+
+    // a pooled buffer, handed back to its pool when destroyed or reset
+    class Buffer {
+      public:
+        Buffer() = default;
+        ~Buffer() { reset(); }
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        Buffer(Buffer&& other) noexcept
+            : pool{std::exchange(other.pool, nullptr)},
+              storage{std::move(other.storage)}, size_class{other.size_class} {
+        }
+        Buffer& operator=(Buffer&& other) noexcept {
+            if (this != &other) {
+                reset();
+                pool = std::exchange(other.pool, nullptr);
+                storage = std::move(other.storage);
+                size_class = other.size_class;
+            }
+            return *this;
+        }
+
+        char* data() const { return storage.get(); }
+        std::size_t size() const {
+            return storage ? min_buffer_size_v << size_class : 0;
+        }
+        explicit operator bool() const { return storage != nullptr; }
+
+        void reset();
+
+      private:
+        friend class BufferPool;
+        Buffer(BufferPool* pool, std::unique_ptr<char[]> storage,
+               std::size_t size_class)
+            : pool{pool}, storage{std::move(storage)}, size_class{size_class} {}
+
+        BufferPool* pool = nullptr;
+        std::unique_ptr<char[]> storage;
+        std::size_t size_class = 0;
+    };
+
+    // at most max_free_per_class released buffers are kept per size class,
+    // the rest are freed
+    explicit BufferPool(std::size_t max_free_per_class = 256);
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // a buffer of at least size bytes, or of max_buffer_size_v bytes if more
+    // was asked for
+    Buffer acquire(std::size_t size);
+
+  private:
+    void release(std::unique_ptr<char[]> storage, std::size_t size_class);
+
+    struct SizeClass {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<char[]>> free;
+    };
+    std::array<SizeClass, size_classes_v> classes;
+    std::size_t max_free_per_class;
+};
+
+} // namespace http
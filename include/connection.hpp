@@ -1,38 +1,119 @@
 #pragma once
 
+#include "buffer_pool.hpp"
+#include "http2.hpp"
+#include "proxy.hpp"
 #include "request.hpp"
 #include "request_handler.hpp"
 #include "request_parser.hpp"
 #include "response.hpp"
 
 #include <asio/ip/tcp.hpp>
+#include <asio/ssl.hpp>
+#include <asio/steady_timer.hpp>
+#include <chrono>
+#include <memory>
+#include <variant>
 
 namespace http {
 
+struct ConnectionOptions {
+    // responses up to this size are written from one contiguous buffer,
+    // larger ones are corked instead
+    std::size_t coalesce_threshold = 16 * 1024;
+    // request line and headers past this size are answered with 431
+    std::size_t max_header_size = RequestParser::default_max_head_size_v;
+};
+
 class Connection : public std::enable_shared_from_this<Connection> {
   public:
-    explicit Connection(asio::ip::tcp::socket socket, RequestHandler& handler);
+    using TlsStream = asio::ssl::stream<asio::ip::tcp::socket>;
+
+    explicit Connection(asio::ip::tcp::socket socket, RequestHandler& handler,
+                        ProxyHandler& proxy, BufferPool& buffers,
+                        ConnectionOptions options);
+    explicit Connection(TlsStream stream, RequestHandler& handler,
+                        ProxyHandler& proxy, BufferPool& buffers,
+                        ConnectionOptions options);
 
     Connection(const Connection&) = delete;
     Connection& operator=(const Connection&) = delete;
 
     void start();
 
+    // Wind the connection down: an HTTP/1.0 connection that is answering a
+    // request is closed after its response as usual, one that hasn't sent a
+    // complete request yet is closed once it stays silent for idle_after, and
+    // HTTP/2 connections stop taking new streams. Safe to call from any
+    // thread
+    void stop();
+
   private:
+    void do_handshake();
     void do_write();
     void do_read();
+    void read_available();
+    void on_read(const asio::error_code& err, std::size_t bytes_read);
+    void do_write_http2();
+    void do_proxy();
+    void do_shutdown();
+    void close_socket();
+
+    // close the connection unless the tls handshake or shutdown started next
+    // completes within timeout, its handler disarms the returned timer
+    std::shared_ptr<asio::steady_timer>
+    arm_deadline(std::chrono::steady_clock::duration timeout);
+    static void disarm_deadline(asio::steady_timer& timer);
+    void wind_down();
+
+    // hold back partial segments until uncorked, so the head of a large
+    // response shares its first segment with the body
+    void set_cork(bool enabled);
 
-    asio::ip::tcp::socket socket;
-    constexpr static inline std::size_t buffer_max_size = 1024;
-    std::string buffer = std::string(buffer_max_size, '\0');
+    void on_input(std::string_view input);
+    void on_http1_input(std::string_view input);
+    void on_http2_input(std::string_view input);
+
+    // plain tcp or tls, every read and write goes through std::visit
+    std::variant<asio::ip::tcp::socket, TlsStream> stream;
+    ConnectionOptions options;
+
+    // reads borrow a buffer from the pool and hand it back once the input is
+    // consumed. The next read asks for a bigger one whenever a read fills it
+    BufferPool& buffers;
+    BufferPool::Buffer read_buffer;
+    std::size_t read_size = BufferPool::min_buffer_size_v;
+
+    // a connection that was just accepted, or just sent part of a request,
+    // most likely has the rest on the way, so it only counts as idle once it
+    // stayed silent for this long
+    constexpr static inline auto idle_after = std::chrono::seconds{1};
+    std::chrono::steady_clock::time_point last_input_at =
+        std::chrono::steady_clock::now();
+    bool responding = false; // a complete request was read
+
+    // longest a client may take to complete the tls handshake, or to answer
+    // close_notify, before the connection is closed under it
+    constexpr static inline auto tls_timeout = std::chrono::seconds{5};
 
     Request request;
     RequestParser parser;
     RequestHandler& handler;
+    ProxyHandler& proxy;
+    std::string proxy_path; // normalized path of a proxied request
 
     Response response;
+    std::string write_buffer;
+
+    // set once the connection speaks HTTP/2, either negotiated through ALPN
+    // or, without TLS, by starting with the client preface (prior knowledge)
+    std::unique_ptr<http2::Session> http2;
+    bool sniffing_preface = false;
+    std::size_t preface_matched = 0;
+    bool writing = false;
+    bool reading_paused = false; // until the session's output backlog drains
 };
 
 using ConnectionPtr = std::shared_ptr<Connection>;
 
-} // namespace http
\ No newline at end of file
+} // namespace http
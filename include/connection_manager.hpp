@@ -0,0 +1,38 @@
+#pragma once
+
+#include "connection.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace http {
+
+// Keeps track of the connections a server accepted without keeping them
+// alive, so they can be asked to wind down when the server stops
+class ConnectionManager {
+  public:
+    ConnectionManager() = default;
+
+    ConnectionManager(const ConnectionManager&) = delete;
+    ConnectionManager& operator=(const ConnectionManager&) = delete;
+
+    void add(const ConnectionPtr& connection);
+
+    // stop() every connection that is still open
+    void stop_all();
+
+    // number of connections that are still open
+    std::size_t size();
+
+  private:
+    // forget connections that have been destroyed since
+    void prune();
+
+    std::mutex mutex;
+    std::vector<std::weak_ptr<Connection>> connections;
+    std::size_t prune_at = 64; // prune again once connections grows this big
+};
+
+} // namespace http
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http {
+
+struct WarmUpOptions {
+    bool enabled = false;
+    // total bytes of file content kept in memory, files are preloaded while
+    // they fit
+    std::size_t preload_budget = 0;
+    std::size_t threads = 0; // walkers, 0 for one per hardware thread
+};
+
+// entity tag of a file, it changes whenever the size or mtime of the file does
+std::string to_etag(std::size_t size, std::time_t modified);
+
+// metadata of a regular file beneath the document root
+struct IndexedFile {
+    std::size_t size = 0;
+    std::time_t modified = 0;
+    std::string etag;
+    std::string_view mime_type;
+    bool preloaded = false;
+    std::string content; // the whole file when preloaded
+};
+
+// Snapshot of every regular file beneath the document root, built once by
+// walking the root in parallel and never modified afterwards, so it can be
+// shared by all threads without locking. Files are keyed by their normalized
+// path, e.g "/images/logo.png". Symlinks aren't followed, requests for them
+// are resolved against the filesystem.
+class DocumentIndex {
+  public:
+    struct Stats {
+        std::size_t files = 0;
+        std::size_t preloaded_files = 0;
+        std::size_t preloaded_bytes = 0;
+        std::size_t memory = 0; // approximate, including preloaded content
+        std::chrono::milliseconds elapsed{};
+    };
+
+    // walk the directory root refers to, an O_PATH descriptor works too
+    static std::shared_ptr<const DocumentIndex>
+    build(int root, const WarmUpOptions& options);
+
+    const IndexedFile* find(std::string_view path) const;
+    const Stats& stats() const { return statistics; }
+
+  private:
+    // allows looking up std::string keys with a std::string_view
+    struct Hash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view str) const {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    std::unordered_map<std::string, IndexedFile, Hash, std::equal_to<>> files;
+    Stats statistics;
+};
+
+} // namespace http
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cerrno>
+#include <string>
+#include <unistd.h>
+#include <utility>
+
+namespace http {
+
+// owns a POSIX file descriptor and closes it when it goes out of scope
+class FileDescriptor {
+  public:
+    FileDescriptor() = default;
+    explicit FileDescriptor(int fd) : fd{fd} {}
+    ~FileDescriptor() { reset(); }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    FileDescriptor(FileDescriptor&& other) noexcept
+        : fd{std::exchange(other.fd, -1)} {}
+    FileDescriptor& operator=(FileDescriptor&& other) noexcept {
+        if (this != &other) {
+            reset(std::exchange(other.fd, -1));
+        }
+        return *this;
+    }
+
+    int get() const { return fd; }
+    explicit operator bool() const { return fd >= 0; }
+
+    // give up ownership without closing the descriptor
+    int release() { return std::exchange(fd, -1); }
+
+    void reset(int new_fd = -1) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = new_fd;
+    }
+
+  private:
+    int fd = -1;
+};
+
+// fill buffer with the contents of fd, retrying short and interrupted reads
+inline bool read_all(int fd, std::string& buffer) {
+    auto offset = 0uz;
+    while (offset < buffer.size()) {
+        auto n = ::read(fd, buffer.data() + offset, buffer.size() - offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        offset += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+} // namespace http
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "file_descriptor.hpp"
+
+#include <chrono>
+#include <string>
+
+namespace http {
+
+// Listening sockets are handed from a running server to its replacement over
+// a unix socket (SCM_RIGHTS), so connections queued on the socket are
+// accepted by whichever process is running and none are refused during a
+// restart. Both ends only deal with processes of the same user.
+
+// Ask the server listening for handoffs at path for its listening socket.
+// Returns an empty descriptor if no server is listening there, or if it
+// doesn't hand its socket over within timeout
+FileDescriptor
+receive_listener(const std::string& path,
+                 std::chrono::milliseconds timeout = std::chrono::seconds{5});
+
+// Send listener over the connected unix socket, returns false on failure
+bool send_listener(int socket, int listener);
+
+// whether the peer of the connected unix socket runs as the effective user
+// of this process, the only one a listening socket is handed to or taken from
+bool is_same_user(int socket);
+
+} // namespace http
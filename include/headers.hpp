@@ -0,0 +1,99 @@
+#pragma once
+
+#include "header.hpp"
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http {
+
+// header fields that are looked up often enough to get a fixed slot in
+// Headers
+enum class KnownHeader : std::uint8_t {
+    Accept,
+    AcceptEncoding,
+    AcceptLanguage,
+    Authorization,
+    CacheControl,
+    Connection,
+    ContentLength,
+    ContentType,
+    Cookie,
+    Expect,
+    Forwarded,
+    Host,
+    IfMatch,
+    IfModifiedSince,
+    IfNoneMatch,
+    IfRange,
+    IfUnmodifiedSince,
+    KeepAlive,
+    Origin,
+    ProxyConnection,
+    Range,
+    Referer,
+    TE,
+    TransferEncoding,
+    Upgrade,
+    UserAgent,
+    XForwardedFor,
+    XForwardedProto,
+};
+
+constexpr inline std::size_t known_header_count_v =
+    static_cast<std::size_t>(KnownHeader::XForwardedProto) + 1;
+
+// canonical spelling of a well-known field name, e.g "Accept-Encoding"
+std::string_view to_string(KnownHeader header);
+
+// classify a field name case-insensitively, empty if it has no slot
+std::optional<KnownHeader> to_known_header(std::string_view name);
+
+bool iequals(std::string_view lhs, std::string_view rhs);
+
+// Header fields of a request. Well-known fields live in fixed slots, so
+// looking them up is a single index, and the rest go into a small
+// case-insensitive map. Repeated fields are combined into one value, as
+// RFC 9110 allows.
+class Headers {
+  public:
+    void add(std::string_view name, std::string_view value);
+    void add(KnownHeader header, std::string_view value);
+
+    std::optional<std::string_view> get(KnownHeader header) const;
+    std::optional<std::string_view> get(std::string_view name) const;
+
+    bool contains(KnownHeader header) const {
+        return present.test(static_cast<std::size_t>(header));
+    }
+
+    std::size_t size() const { return present.count() + other.size(); }
+    bool empty() const { return size() == 0; }
+    void clear();
+
+    // call f(name, value) for every field, well-known ones first
+    template <typename F> void for_each(F&& f) const {
+        for (auto i = 0uz; i < known_header_count_v; ++i) {
+            if (present.test(i)) {
+                f(to_string(static_cast<KnownHeader>(i)),
+                  std::string_view{known[i]});
+            }
+        }
+        for (const auto& header : other) {
+            f(std::string_view{header.name}, std::string_view{header.value});
+        }
+    }
+
+  private:
+    std::array<std::string, known_header_count_v> known;
+    std::bitset<known_header_count_v> present;
+    std::vector<Header> other; // in arrival order, names compared with iequals
+};
+
+} // namespace http
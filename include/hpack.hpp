@@ -0,0 +1,84 @@
+#pragma once
+
+#include "header.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// HPACK header compression for HTTP/2 (RFC 7541)
+namespace http::hpack {
+
+// SETTINGS_HEADER_TABLE_SIZE both endpoints start with
+constexpr std::size_t default_table_size_v = 4096;
+
+// The static table of RFC 7541 Appendix A followed by a dynamic table of
+// recently used fields. Both are addressed with a single 1-based index.
+class Table {
+  public:
+    struct Field {
+        std::string_view name, value;
+    };
+
+    struct Match {
+        std::size_t index = 0; // 0 if nothing matched
+        bool exact = false;    // name and value matched, not only the name
+    };
+
+    explicit Table(std::size_t max_size = default_table_size_v);
+
+    std::optional<Field> at(std::size_t index) const;
+    Match find(std::string_view name, std::string_view value) const;
+
+    // add a field in front of the dynamic table, evicting the oldest fields
+    // until it fits
+    void insert(std::string_view name, std::string_view value);
+    void set_max_size(std::size_t max_size);
+
+  private:
+    void evict_to(std::size_t target_size);
+
+    std::deque<Header> entries; // newest first
+    std::size_t size = 0;       // as defined by RFC 7541 4.1
+    std::size_t max_size;
+};
+
+class Decoder {
+  public:
+    // max_table_size is the SETTINGS_HEADER_TABLE_SIZE we advertised, the
+    // largest table the peer may ask for with a size update.
+    // max_list_size bounds the decoded size of one header block
+    explicit Decoder(std::size_t max_table_size = default_table_size_v,
+                     std::size_t max_list_size = 64 * 1024);
+
+    // Decode a complete header block, appending its fields to headers.
+    // Returns false on a compression error, after which the connection's
+    // header table is out of sync and the connection has to be closed
+    bool decode(std::string_view block, std::vector<Header>& headers);
+
+  private:
+    Table table;
+    std::size_t max_table_size;
+    std::size_t max_list_size;
+};
+
+class Encoder {
+  public:
+    // Start a new header block. Has to be called before encoding its first
+    // field, so pending table size updates are sent first
+    void begin_block(std::string& out);
+    void encode(std::string_view name, std::string_view value,
+                std::string& out);
+
+    // the peer changed its SETTINGS_HEADER_TABLE_SIZE
+    void set_max_table_size(std::size_t size);
+
+  private:
+    Table table;
+    std::optional<std::size_t> pending_size_update;
+};
+
+} // namespace http::hpack
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "hpack.hpp"
+#include "request.hpp"
+#include "response.hpp"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+namespace http {
+
+class ProxyHandler;
+class RequestHandler;
+
+namespace http2 {
+
+// sent by clients before their first frame, RFC 9113 3.4
+constexpr std::string_view client_preface_v =
+    "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+// HTTP/2 protocol state of a single connection (RFC 9113), independent of
+// any I/O: bytes read from the peer are fed to consume(), and the frames
+// queued in reply are taken with next_output() and written by the caller.
+// Requests are answered by the same RequestHandler as HTTP/1.0 requests.
+// Proxied requests are refused with HTTP_1_1_REQUIRED, so clients retry them
+// over HTTP/1.x where responses can be streamed from upstream.
+class Session {
+  public:
+    explicit Session(RequestHandler& handler, const ProxyHandler& proxy);
+
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    // Process input from the peer, handling every request it completes.
+    // Returns false once the connection failed; a GOAWAY is queued and the
+    // connection should be closed after the output is flushed
+    bool consume(std::string_view input);
+
+    // Frames to write next, including response data the flow control windows
+    // allow. The returned view stays valid until output_written() is called
+    std::string_view next_output();
+    void output_written();
+
+    // Whether more output is queued than a peer should be able to cause
+    // without reading it, e.g by flooding PINGs or SETTINGS that each get an
+    // ACK. Input shouldn't be read until the output was written
+    bool backlogged() const;
+
+    // Stop accepting new streams with a GOAWAY, letting the ones already
+    // open complete
+    void go_away();
+
+    // true once no more requests will be served and all output was taken
+    bool finished() const;
+
+  private:
+    enum class FrameType : std::uint8_t {
+        Data = 0x0,
+        Headers = 0x1,
+        Priority = 0x2,
+        RstStream = 0x3,
+        Settings = 0x4,
+        PushPromise = 0x5,
+        Ping = 0x6,
+        GoAway = 0x7,
+        WindowUpdate = 0x8,
+        Continuation = 0x9,
+    };
+
+    enum class ErrorCode : std::uint32_t {
+        NoError = 0x0,
+        ProtocolError = 0x1,
+        InternalError = 0x2,
+        FlowControlError = 0x3,
+        StreamClosed = 0x5,
+        FrameSizeError = 0x6,
+        RefusedStream = 0x7,
+        CompressionError = 0x9,
+        Http11Required = 0xd,
+    };
+
+    struct Frame {
+        std::uint32_t length;
+        FrameType type;
+        std::uint8_t flags;
+        std::uint32_t stream_id;
+        std::string_view payload;
+    };
+
+    struct Stream {
+        std::int64_t send_window;
+        int weight = 16; // 1-256, share of bandwidth relative to siblings
+        // virtual time of the stream's next DATA frame, the stream with the
+        // lowest one is scheduled next
+        std::uint64_t pass = 0;
+        bool request_complete = false; // END_STREAM received
+        bool responding = false;       // HEADERS sent, data may follow
+
+        Request request;
+        Response response;
+        std::string_view body; // response content left to be sent
+    };
+
+    bool on_frame(const Frame& frame);
+    bool on_data(const Frame& frame);
+    bool on_headers(const Frame& frame);
+    bool on_continuation(const Frame& frame);
+    bool on_priority(const Frame& frame);
+    bool on_rst_stream(const Frame& frame);
+    bool on_settings(const Frame& frame);
+    bool on_ping(const Frame& frame);
+    bool on_goaway(const Frame& frame);
+    bool on_window_update(const Frame& frame);
+
+    // a complete header block was received for stream_id
+    bool on_header_block(std::uint32_t stream_id, bool end_stream);
+    void respond(std::uint32_t stream_id, Stream& stream);
+
+    // queue as many DATA frames as the windows and output budget allow
+    void schedule_data();
+
+    void queue_frame(FrameType type, std::uint8_t flags,
+                     std::uint32_t stream_id, std::string_view payload = {});
+    void queue_window_update(std::uint32_t stream_id, std::uint32_t increment);
+    void reset_stream(std::uint32_t stream_id, ErrorCode code);
+    bool connection_error(ErrorCode code);
+
+    RequestHandler& handler;
+    const ProxyHandler& proxy;
+    hpack::Decoder decoder;
+    hpack::Encoder encoder;
+
+    std::string input;  // received bytes not yet parsed into frames
+    std::string output; // queued frames
+    std::string writing; // frames handed out by next_output()
+
+    bool preface_received = false;
+    bool settings_received = false;
+    bool going_away = false; // no new streams are accepted
+    bool failed = false;
+
+    std::map<std::uint32_t, Stream> streams;
+    std::uint32_t last_stream_id = 0;
+    std::uint64_t virtual_time = 0;
+
+    // header block split over HEADERS and CONTINUATION frames
+    std::uint32_t continuation_stream_id = 0;
+    bool continuation_end_stream = false;
+    int header_block_weight = 16;
+    std::string header_block;
+
+    // peer settings
+    std::uint32_t peer_max_frame_size = 16384;
+    std::int64_t peer_initial_window_size = 65535;
+    std::int64_t send_window = 65535; // connection level
+};
+
+} // namespace http2
+
+} // namespace http
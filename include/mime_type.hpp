@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string_view>
+
+namespace http {
+
+// MIME type for a path, based on its extension. Defaults to "text/plain"
+std::string_view to_mime_type(std::string_view path);
+
+} // namespace http
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http {
+
+// Remembers paths that recently failed to resolve, so repeated requests for
+// missing files can be answered without touching the filesystem.
+// Entries expire after `ttl`, and once `capacity` paths are cached the oldest
+// one is evicted to make room for a new one.
+class NegativeCache {
+    using clock = std::chrono::steady_clock;
+
+  public:
+    explicit NegativeCache(std::size_t capacity, clock::duration ttl);
+
+    NegativeCache(const NegativeCache&) = delete;
+    NegativeCache& operator=(const NegativeCache&) = delete;
+
+    // true if path is known to be missing and the entry has not expired yet
+    bool contains(std::string_view path) const;
+    void insert(std::string_view path);
+    void clear();
+
+  private:
+    // allows looking up std::string keys with a std::string_view
+    struct Hash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view str) const {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    mutable std::shared_mutex mutex;
+    std::unordered_map<std::string, clock::time_point, Hash, std::equal_to<>>
+        expiry;
+    std::deque<std::string> insertion_order; // eviction order of expiry keys
+
+    std::size_t capacity;
+    clock::duration ttl;
+};
+
+} // namespace http
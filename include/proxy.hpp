@@ -0,0 +1,94 @@
+#pragma once
+
+#include <asio/any_io_executor.hpp>
+#include <asio/io_context.hpp>
+#include <asio/ip/tcp.hpp>
+#include <asio/steady_timer.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http {
+
+struct Request;
+
+struct Upstream {
+    std::string host, port;
+};
+
+struct ProxyRoute {
+    enum class Balancing {
+        RoundRobin,
+        LeastConnections,
+    };
+
+    // requests whose normalized path (see decode_url) starts with prefix
+    // are forwarded to the upstreams
+    std::string prefix;
+    std::vector<Upstream> upstreams;
+    Balancing balancing = Balancing::RoundRobin;
+};
+
+// Where a proxied response is written to, usually a client connection
+struct ProxySink {
+    // write a chunk of the response, done is called with false if the client
+    // went away. The chunk has to stay alive until done is called
+    std::function<void(std::string_view chunk, std::function<void(bool)> done)>
+        write;
+    // the response was written completely, or cut short by an upstream error
+    std::function<void()> finish;
+};
+
+// Forwards requests that match a route to one of its upstream servers over
+// HTTP/1.1, streaming the upstream response back to the client as it arrives.
+// Upstream connections are kept alive in a pool sharded by thread and reused
+// by later requests. Upstreams that keep failing are ejected from balancing
+// until a periodic health check can connect to them again.
+class ProxyHandler {
+  public:
+    explicit ProxyHandler(asio::io_context& context,
+                          std::vector<ProxyRoute> routes);
+    ~ProxyHandler();
+
+    ProxyHandler(const ProxyHandler&) = delete;
+    ProxyHandler& operator=(const ProxyHandler&) = delete;
+
+    // Whether req is routed to an upstream. path is set to the normalized
+    // path it was matched by, which forward takes along with it
+    bool matches(const Request& req, std::string& path) const;
+
+    // Forward req, whose normalized path matched a route, to an upstream of
+    // that route and stream the response into sink. client_address is
+    // reported upstream in X-Forwarded-For, and every completion handler runs
+    // on executor. Request bodies are never read, so requests that carry one
+    // are answered with 501 instead
+    void forward(const Request& req, std::string_view path,
+                 std::string client_address, asio::any_io_executor executor,
+                 ProxySink sink);
+
+    // stop health checks and close idle upstream connections, exchanges
+    // still in flight are left to finish
+    void stop();
+
+  private:
+    struct UpstreamState;
+    struct Route;
+    class Exchange;
+
+    Route* find_route(std::string_view path) const;
+    std::shared_ptr<UpstreamState> select_upstream(Route& route);
+
+    void schedule_health_check();
+    void do_health_check();
+
+    asio::io_context& context;
+    std::vector<std::unique_ptr<Route>> routes;
+    // on a strand, so stop() can cancel it while a check is being scheduled
+    asio::steady_timer health_check_timer;
+    bool stopped = false; // only accessed on the timer's strand
+};
+
+} // namespace http
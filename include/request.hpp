@@ -1,7 +1,7 @@
 #pragma once
 
-#include "header.hpp"
-#include <vector>
+#include "headers.hpp"
+#include <string>
 
 namespace http {
 
@@ -11,7 +11,7 @@ struct Request {
         int major = {};
         int minor = {};
     } version;
-    std::vector<http::Header> headers;
+    Headers headers;
 };
 
 } // namespace http
\ No newline at end of file
@@ -1,23 +1,86 @@
 #pragma once
 
+#include "document_index.hpp"
+#include "file_descriptor.hpp"
+#include "negative_cache.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 
 namespace http {
 
 struct Request;
 class Response;
 
+// Decode the path of a request uri into out, normalizing it in the same pass:
+// "//" and "/./" are collapsed and the query string is dropped.
+// Returns false if the path is not absolute, has malformed escapes, decodes to
+// a NUL byte or contains a ".." segment.
+bool decode_url(std::string_view uri, std::string& out);
+
+// Percent-encode a path decoded by decode_url for use in a uri, so decoding
+// the result gives the path back unchanged.
+std::string encode_url(std::string_view path);
+
 class RequestHandler {
   public:
-    explicit RequestHandler(const std::string& root);
+    // with warm-up enabled, the document root is indexed (and files are
+    // preloaded) before the handler is ready
+    explicit RequestHandler(const std::string& root,
+                            WarmUpOptions warm_up = {});
 
     RequestHandler(const RequestHandler&) = delete;
     RequestHandler& operator=(const RequestHandler&) = delete;
 
     Response handle(const Request& req);
 
+    // Reopen the document root and forget cached lookups, so a root that is
+    // a symlink to the current release picks up a new one. Requests keep
+    // being served from the old root if the new one can't be opened
+    bool reload();
+
+    // a reopened document root and its index, ready to be swapped in
+    struct Reloaded {
+        FileDescriptor root;
+        std::shared_ptr<const DocumentIndex> index;
+    };
+
+    // reload() in two steps: the slow one reopens the root and rebuilds the
+    // index while requests are served from the old ones, and can run on any
+    // thread. Empty if the root can't be reopened
+    std::optional<Reloaded> prepare_reload() const;
+    void apply_reload(Reloaded reloaded);
+
+    // the current index of the document root, empty without warm-up
+    std::shared_ptr<const DocumentIndex> document_index() const {
+        return index.load();
+    }
+
   private:
-    std::string root;
+    // open a normalized path beneath the document root
+    FileDescriptor open_beneath_root(const std::string& path) const;
+
+    // document root directory, every path is resolved relative to it
+    std::string root_path;
+    FileDescriptor root;
+    mutable std::shared_mutex root_mutex; // held shared while root is used
+
+    // paths that recently resolved to nothing, answered with 404 without a
+    // filesystem lookup
+    constexpr static inline std::size_t missing_cache_capacity = 4096;
+    constexpr static inline auto missing_cache_ttl = std::chrono::seconds{5};
+    NegativeCache missing;
+
+    // preloaded files are served from the index, other indexed files take
+    // their headers from it as long as their size and mtime still match.
+    // Rebuilt on reload and swapped in while requests keep using the old one
+    WarmUpOptions warm_up;
+    std::atomic<std::shared_ptr<const DocumentIndex>> index;
 };
 
-} // namespace http
\ No newline at end of file
+} // namespace http
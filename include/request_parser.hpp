@@ -1,5 +1,8 @@
 #pragma once
 
+#include "header.hpp"
+
+#include <cstddef>
 #include <string_view>
 
 namespace http {
@@ -12,14 +15,24 @@ class RequestParser {
         Indeterminate = -1,
         Complete,
         Invalid,
+        TooLarge, // request line and headers exceed max_head_size
     };
 
+    constexpr static inline std::size_t default_max_head_size_v = 8 * 1024;
+
+    explicit RequestParser(std::size_t max_head_size = default_max_head_size_v)
+        : max_head_size{max_head_size} {}
+
     // Parse input and populate request data.
     // Returns Result::Indeterminate if the request data was not fully
     // populated by available input
     auto parse(Request& req, std::string_view input) noexcept -> Result;
 
-    void reset() { state = {}; };
+    void reset() {
+        state = {};
+        head_size = 0;
+        field = {};
+    };
 
   private:
     auto consume(Request& req, char c) -> Result;
@@ -50,6 +63,14 @@ class RequestParser {
 
         RequestEnd,
     } state = {};
+
+    // bytes consumed by the current request, bounds how far a client can
+    // grow the request before it is rejected
+    std::size_t head_size = 0;
+    std::size_t max_head_size;
+
+    // the header line being parsed, added to the request once it ends
+    Header field;
 };
 
 } // namespace http
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include "header.hpp"
 
 #include <asio/buffer.hpp>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace http {
@@ -26,25 +28,61 @@ class Response {
         Unauthorized = 401,
         Forbidden = 403,
         NotFound = 404,
+        RequestHeaderFieldsTooLarge = 431,
         // Server Error 5xx
         InternalServerError = 500,
         NotImplemented = 501,
         BadGateway = 502,
         ServiceUnavailable = 503,
+        GatewayTimeout = 504,
     };
 
-    // create a generic Response from a status code
+    // create a generic Response from a status code. The returned response
+    // refers to a stock response that is serialized once and shared by all
+    // connections, so it is cheap to create
     static Response from(StatusCode code);
-    auto to_buffers() -> std::vector<asio::const_buffer>;
+
+    // the fully populated (status, headers and content) stock response for a
+    // status code
+    static const Response& stock(StatusCode code);
+
+    auto to_buffers() const -> std::vector<asio::const_buffer>;
+
+    // number of bytes the response takes on the wire
+    std::size_t size() const;
+
+    // append the wire form of the response to out, for writing it as one
+    // contiguous buffer instead of many small ones
+    void serialize_to(std::string& out) const;
+
+    // the content to send, from whichever member holds it
+    std::string_view body() const;
 
     StatusCode status;
     // note: asio::buffers are non-owning views, so response information has to
     // be able to outlive the asio::buffers
-    std::string status_line;
     std::string content;
+    // content owned elsewhere and shared instead of copied, e.g. a file
+    // preloaded into the document index. When set, content is ignored
+    std::shared_ptr<const std::string> shared_content;
     std::vector<Header> headers;
+    // value of the Date header, shared with the cache http_date() keeps and
+    // written after the other headers. Empty for no Date header
+    std::shared_ptr<const std::string> date;
+
+    // pre-serialized wire form of a stock response. When set, to_buffers()
+    // emits it as a single buffer and headers/content are ignored
+    std::string_view serialized;
 };
 
 std::string_view to_string(Response::StatusCode code);
 
+// status line for a status code, e.g "HTTP/1.0 200 Ok\r\n"
+std::string_view to_status_line(Response::StatusCode code);
+
+// current time formatted as an HTTP date, reformatted at most once a second
+// per thread. A new string is made every time, so responses still being
+// written keep the date they were given
+std::shared_ptr<const std::string> http_date();
+
 } // namespace http
\ No newline at end of file
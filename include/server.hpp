@@ -1,19 +1,58 @@
 #pragma once
 
+#include "buffer_pool.hpp"
+#include "connection.hpp"
+#include "connection_manager.hpp"
+#include "proxy.hpp"
 #include "request_handler.hpp"
+#include "tls.hpp"
 
 #include <asio/io_context.hpp>
 #include <asio/ip/tcp.hpp>
+#include <asio/local/stream_protocol.hpp>
 #include <asio/signal_set.hpp>
+#include <asio/ssl.hpp>
+#include <asio/steady_timer.hpp>
+#include <asio/strand.hpp>
+#include <chrono>
+#include <optional>
+#include <thread>
 
 namespace http {
 
+// tuning for the listening socket and the connections it accepts. Zero keeps
+// the system default
+struct SocketOptions {
+    bool no_delay = true;     // TCP_NODELAY on accepted connections
+    int send_buffer_size = 0; // SO_SNDBUF, in bytes
+    int defer_accept = 0;     // TCP_DEFER_ACCEPT, in seconds
+    int fast_open_queue = 0;  // TCP_FASTOPEN pending connection queue
+};
+
+// how the server stops and hands over to its replacement
+struct LifecycleOptions {
+    // how long open connections get to finish their requests once the server
+    // is stopping, before they are cut off
+    std::chrono::seconds drain_timeout{10};
+    // unix socket the listening socket is handed over on. A server started
+    // with the same path takes over from the one running, which then drains
+    std::string handoff_path;
+};
+
 class Server {
     using tcp = asio::ip::tcp;
 
   public:
+    // serves https instead of http when a tls configuration is given, and
+    // forwards requests matching a proxy route instead of serving files
     explicit Server(std::string address, std::string port, std::string doc_root,
-                    std::size_t thread_pool_size);
+                    std::size_t thread_pool_size,
+                    std::optional<TlsConfig> tls = std::nullopt,
+                    std::vector<ProxyRoute> proxy_routes = {},
+                    SocketOptions socket_options = {},
+                    ConnectionOptions connection_options = {},
+                    LifecycleOptions lifecycle_options = {},
+                    WarmUpOptions warm_up = {});
 
     Server(const Server&) = delete;
     Server& operator=(const Server&) = delete;
@@ -21,18 +60,61 @@ class Server {
     void listen_and_serve();
 
   private:
-    void do_accept();     // listen and accept connections
-    void do_await_stop(); // wait for server stop signal
+    void do_accept();       // listen and accept connections
+    void do_await_signal(); // wait for a stop or reload signal
+    void do_accept_handoff();
+
+    // take over the listening socket of a running server, or bind a new one
+    void listen(const std::string& address, const std::string& port);
+    void listen_for_handoff();
+
+    // stop accepting and let open connections finish up to the deadline
+    void drain();
+    void do_await_drained();
+
+    // reopen the document root and drop cached lookups. The root is reopened
+    // and reindexed on reload_thread, only the swap runs on the strand
+    void reload();
+    void finish_reload(std::optional<RequestHandler::Reloaded> reloaded);
+    void report_index() const;
+
+    void apply_socket_options(tcp::socket& socket) const;
+
+    // declared before the context, since connections still queued in it
+    // hand their buffers back when it is destroyed
+    BufferPool buffers;
 
     asio::io_context context;
 
-    // configure signals that will initiate server shutdown
+    // accepting, signals and draining are serialized on this strand
+    asio::strand<asio::io_context::executor_type> strand;
+
+    // SIGINT and SIGTERM drain the server, a second one stops it right away.
+    // SIGHUP reloads the document root
     asio::signal_set signals;
 
     tcp::acceptor acceptor;
+    asio::local::stream_protocol::acceptor handoff_acceptor;
+    std::optional<asio::ssl::context> tls_context;
+
+    ConnectionManager connections;
+    asio::steady_timer drain_timer;
+    std::chrono::steady_clock::time_point drain_deadline;
+    bool draining = false;
 
     std::size_t thread_pool_size;
+    SocketOptions socket_options;
+    ConnectionOptions connection_options;
+    LifecycleOptions lifecycle_options;
     RequestHandler handler;
+    ProxyHandler proxy;
+
+    // declared after the handler, so a reload still running finishes before
+    // the handler is destroyed. reloading and reload_pending are only
+    // accessed on the strand
+    std::jthread reload_thread;
+    bool reloading = false;
+    bool reload_pending = false; // asked again while reloading
 };
 
 } // namespace http
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <asio/ssl.hpp>
+#include <string>
+
+namespace http {
+
+struct TlsConfig {
+    std::string certificate_chain; // PEM file, leaf certificate first
+    std::string private_key;       // PEM file
+};
+
+// Create a server side TLS context from config.
+// The context keeps a server side session cache and issues session tickets so
+// returning clients can resume without a full handshake, and asks OpenSSL to
+// offload record encryption to the kernel (kTLS) where both support it.
+// HTTP/2 is preferred over HTTP/1.1 during ALPN negotiation.
+asio::ssl::context make_tls_context(const TlsConfig& config);
+
+} // namespace http
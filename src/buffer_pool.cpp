@@ -0,0 +1,48 @@
+#include "buffer_pool.hpp"
+
+namespace http {
+
+void BufferPool::Buffer::reset() {
+    if (storage && pool) {
+        pool->release(std::move(storage), size_class);
+    }
+    storage.reset();
+    pool = nullptr;
+}
+
+BufferPool::BufferPool(std::size_t max_free_per_class)
+    : max_free_per_class{max_free_per_class} {}
+
+auto BufferPool::acquire(std::size_t size) -> Buffer {
+    auto size_class = 0uz;
+    while (size_class + 1 < size_classes_v &&
+           (min_buffer_size_v << size_class) < size) {
+        ++size_class;
+    }
+
+    auto& pooled = classes[size_class];
+    {
+        std::lock_guard lock{pooled.mutex};
+        if (!pooled.free.empty()) {
+            auto storage = std::move(pooled.free.back());
+            pooled.free.pop_back();
+            return Buffer{this, std::move(storage), size_class};
+        }
+    }
+
+    return Buffer{this,
+                  std::make_unique_for_overwrite<char[]>(min_buffer_size_v
+                                                         << size_class),
+                  size_class};
+}
+
+void BufferPool::release(std::unique_ptr<char[]> storage,
+                         std::size_t size_class) {
+    auto& pooled = classes[size_class];
+    std::lock_guard lock{pooled.mutex};
+    if (pooled.free.size() < max_free_per_class) {
+        pooled.free.push_back(std::move(storage));
+    }
+}
+
+} // namespace http
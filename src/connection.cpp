@@ -1,60 +1,398 @@
 #include "connection.hpp"
+#include <asio/post.hpp>
+#include <asio/steady_timer.hpp>
 #include <asio/write.hpp>
 
 #include <cx/logger.hpp>
 #include <iostream>
+#include <netinet/tcp.h>
 
 static auto connection_logger_v = cx::Logger{std::cout};
 
 namespace http {
 
-Connection::Connection(asio::ip::tcp::socket socket, RequestHandler& handler)
-    : socket{std::move(socket)}, handler{handler} {}
+Connection::Connection(asio::ip::tcp::socket socket, RequestHandler& handler,
+                       ProxyHandler& proxy, BufferPool& buffers,
+                       ConnectionOptions options)
+    : stream{std::move(socket)}, options{options}, buffers{buffers},
+      parser{options.max_header_size}, handler{handler}, proxy{proxy},
+      sniffing_preface{true} {}
 
-void Connection::start() { do_read(); }
+Connection::Connection(TlsStream stream, RequestHandler& handler,
+                       ProxyHandler& proxy, BufferPool& buffers,
+                       ConnectionOptions options)
+    : stream{std::move(stream)}, options{options}, buffers{buffers},
+      parser{options.max_header_size}, handler{handler}, proxy{proxy} {}
+
+void Connection::start() {
+    if (auto* socket = std::get_if<asio::ip::tcp::socket>(&stream)) {
+        // reads are only attempted once the socket is readable, but a
+        // spurious wake up must not block the thread
+        asio::error_code err;
+        std::ignore = socket->non_blocking(true, err);
+        do_read();
+    } else {
+        do_handshake();
+    }
+}
+
+void Connection::stop() {
+    auto self{shared_from_this()};
+    auto executor =
+        std::visit([](auto& s) { return s.get_executor(); }, stream);
+    asio::post(executor, [this, self]() { wind_down(); });
+}
+
+void Connection::wind_down() {
+    if (http2) {
+        http2->go_away();
+        do_write_http2();
+        return;
+    }
+    if (responding) { // closed after its response
+        return;
+    }
+    const auto idle_at = last_input_at + idle_after;
+    if (std::chrono::steady_clock::now() >= idle_at) {
+        close_socket();
+        return;
+    }
+
+    // its request may still be on the way, whether nothing or part of it
+    // arrived so far (or it may turn out to be HTTP/2). Looked at again once
+    // it could have gone silent for idle_after. Only allocated while
+    // stopping, so waiting connections don't each carry a timer
+    auto self{shared_from_this()};
+    auto executor =
+        std::visit([](auto& s) { return s.get_executor(); }, stream);
+    auto timer = std::make_shared<asio::steady_timer>(executor, idle_at);
+    timer->async_wait([this, self, timer](const asio::error_code& err) {
+        if (!err) {
+            wind_down();
+        }
+    });
+}
+
+void Connection::close_socket() {
+    asio::error_code err;
+    std::visit([&](auto& s) { std::ignore = s.lowest_layer().close(err); },
+               stream);
+}
+
+auto Connection::arm_deadline(std::chrono::steady_clock::duration timeout)
+    -> std::shared_ptr<asio::steady_timer> {
+    auto self{shared_from_this()};
+    auto executor =
+        std::visit([](auto& s) { return s.get_executor(); }, stream);
+    auto timer = std::make_shared<asio::steady_timer>(executor, timeout);
+    timer->async_wait([this, self, timer](const asio::error_code& err) {
+        // a deadline that expired just before it was disarmed still runs
+        if (!err && timer->expiry() <= std::chrono::steady_clock::now()) {
+            close_socket();
+        }
+    });
+    return timer;
+}
+
+void Connection::disarm_deadline(asio::steady_timer& timer) {
+    timer.expires_at(asio::steady_timer::time_point::max());
+}
+
+void Connection::do_handshake() {
+    auto self{shared_from_this()};
+    auto deadline = arm_deadline(tls_timeout);
+    std::get<TlsStream>(stream).async_handshake(
+        asio::ssl::stream_base::server,
+        [this, self, deadline](const asio::error_code& err) {
+            disarm_deadline(*deadline);
+            if (err) {
+                connection_logger_v.info("TLS handshake failed: {}",
+                                         err.message());
+                return;
+            }
+
+            const unsigned char* protocol = nullptr;
+            unsigned int length = 0;
+            SSL_get0_alpn_selected(
+                std::get<TlsStream>(stream).native_handle(), &protocol,
+                &length);
+            if (std::string_view{reinterpret_cast<const char*>(protocol),
+                                 length} == "h2") {
+                http2 = std::make_unique<http2::Session>(handler, proxy);
+            }
+            do_read();
+        });
+}
 
 void Connection::do_read() {
     auto self{shared_from_this()};
-    socket.async_read_some(
-        asio::buffer(buffer.data(), buffer_max_size),
+    if (auto* socket = std::get_if<asio::ip::tcp::socket>(&stream)) {
+        // wait without a buffer, so idle connections don't hold on to one
+        socket->async_wait(asio::ip::tcp::socket::wait_read,
+                           [this, self](const asio::error_code& err) {
+                               if (!err) {
+                                   read_available();
+                               }
+                           });
+        return;
+    }
+
+    // openssl needs somewhere to decrypt into as soon as a record arrives,
+    // so tls connections keep their buffer while the read is pending
+    read_buffer = buffers.acquire(read_size);
+    std::get<TlsStream>(stream).async_read_some(
+        asio::buffer(read_buffer.data(), read_buffer.size()),
         [this, self](const asio::error_code& err, std::size_t bytes_read) {
-            if (!err) {
-                auto result =
-                    parser.parse(request, {buffer.data(), bytes_read});
-                switch (result) {
-                case RequestParser::Result::Complete:
-                    response = handler.handle(request);
-                    parser.reset();
-                    do_write();
-                    break;
-                case RequestParser::Result::Invalid: // respond with a generic
-                                                     // Bad Request response
-                    response = Response::from(Response::StatusCode::BadRequest);
-                    parser.reset();
-                    do_write();
-                    break;
-                case RequestParser::Result::Indeterminate: // keep reading
-                    do_read();
-                    break;
-                }
-                connection_logger_v.info(
-                    "Received:\n{}",
-                    std::string_view{buffer.data(), bytes_read});
-            }
+            on_read(err, bytes_read);
         });
 }
 
+void Connection::read_available() {
+    read_buffer = buffers.acquire(read_size);
+    asio::error_code err;
+    auto bytes_read = std::get<asio::ip::tcp::socket>(stream).read_some(
+        asio::buffer(read_buffer.data(), read_buffer.size()), err);
+    if (err == asio::error::would_block) {
+        read_buffer.reset();
+        do_read();
+        return;
+    }
+    on_read(err, bytes_read);
+}
+
+void Connection::on_read(const asio::error_code& err, std::size_t bytes_read) {
+    // handlers may start the next read before they are done with the input,
+    // so the buffer is only handed back once they return
+    auto buffer = std::move(read_buffer);
+    if (err) {
+        return;
+    }
+    last_input_at = std::chrono::steady_clock::now();
+
+    // a full buffer means more is likely waiting; read it in fewer passes
+    if (bytes_read == buffer.size()) {
+        read_size = std::min(2 * buffer.size(),
+                             std::max(options.max_header_size,
+                                      BufferPool::min_buffer_size_v));
+    }
+    on_input({buffer.data(), bytes_read});
+}
+
+void Connection::on_input(std::string_view input) {
+    if (http2) {
+        on_http2_input(input);
+        return;
+    }
+    if (!sniffing_preface) {
+        on_http1_input(input);
+        return;
+    }
+
+    // hold input back for as long as it could still be the client preface
+    const auto& preface = http2::client_preface_v;
+    const auto n = std::min(input.size(), preface.size() - preface_matched);
+    if (input.substr(0, n) != preface.substr(preface_matched, n)) {
+        sniffing_preface = false;
+        if (preface_matched == 0) {
+            on_http1_input(input);
+        } else {
+            auto held_back = std::string{preface.substr(0, preface_matched)};
+            held_back.append(input);
+            on_http1_input(held_back);
+        }
+        return;
+    }
+
+    preface_matched += n;
+    if (preface_matched < preface.size()) {
+        do_read();
+        return;
+    }
+
+    sniffing_preface = false;
+    http2 = std::make_unique<http2::Session>(handler, proxy);
+    http2->consume(preface);
+    on_http2_input(input.substr(n));
+}
+
+void Connection::on_http1_input(std::string_view input) {
+    auto result = parser.parse(request, input);
+    responding = result != RequestParser::Result::Indeterminate;
+    switch (result) {
+    case RequestParser::Result::Complete:
+        if (proxy.matches(request, proxy_path)) {
+            do_proxy();
+            break;
+        }
+        response = handler.handle(request);
+        parser.reset();
+        do_write();
+        break;
+    case RequestParser::Result::Invalid: // respond with a generic
+                                         // Bad Request response
+        response = Response::from(Response::StatusCode::BadRequest);
+        parser.reset();
+        do_write();
+        break;
+    case RequestParser::Result::TooLarge:
+        response =
+            Response::from(Response::StatusCode::RequestHeaderFieldsTooLarge);
+        parser.reset();
+        do_write();
+        break;
+    case RequestParser::Result::Indeterminate: // keep reading
+        do_read();
+        break;
+    }
+    connection_logger_v.info("Received:\n{}", input);
+}
+
+void Connection::on_http2_input(std::string_view input) {
+    // after a connection error the session only flushes its GOAWAY. A peer
+    // that doesn't read what it's sent isn't read from either, until the
+    // output was written
+    if (http2->consume(input)) {
+        if (http2->backlogged()) {
+            reading_paused = true;
+        } else {
+            do_read();
+        }
+    }
+    do_write_http2();
+}
+
 void Connection::do_write() {
+    // small responses go out as one buffer rather than a writev of a few
+    // dozen tiny ones (or, over tls, one record each). Large ones are written
+    // in place, corked so the kernel only sends full segments
+    const auto corked = response.size() > options.coalesce_threshold;
+    auto buffers = std::vector<asio::const_buffer>{};
+    if (corked) {
+        set_cork(true);
+        buffers = response.to_buffers();
+    } else if (!response.serialized.empty()) { // already contiguous
+        buffers = response.to_buffers();
+    } else {
+        write_buffer.clear();
+        response.serialize_to(write_buffer);
+        buffers.push_back(asio::buffer(write_buffer));
+    }
+
     auto self{shared_from_this()};
-    asio::async_write(
-        socket, response.to_buffers(),
-        [this, self](asio::error_code err, std::size_t bytes_written) {
-            if (!err) {
-                std::ignore =
-                    socket.shutdown(asio::ip::tcp::socket::shutdown_both, err);
-                connection_logger_v.info("Connection Closed");
+    auto on_write = [this, self, corked](asio::error_code err,
+                                         std::size_t bytes_written) {
+        if (corked) {
+            set_cork(false); // flush the last partial segment
+        }
+        if (!err) {
+            do_shutdown();
+        }
+    };
+
+    std::visit(
+        [&](auto& s) {
+            asio::async_write(s, std::move(buffers), std::move(on_write));
+        },
+        stream);
+}
+
+void Connection::do_write_http2() {
+    // reads and writes overlap, but only a single write may be in flight
+    if (writing) {
+        return;
+    }
+
+    auto output = http2->next_output();
+    if (output.empty()) {
+        if (http2->finished()) {
+            do_shutdown();
+        }
+        return;
+    }
+
+    writing = true;
+    auto self{shared_from_this()};
+    auto on_write = [this, self](asio::error_code err,
+                                 std::size_t bytes_written) {
+        writing = false;
+        if (!err) {
+            http2->output_written();
+            if (reading_paused && !http2->backlogged()) {
+                reading_paused = false;
+                do_read();
             }
+            do_write_http2();
+        }
+    };
+
+    std::visit(
+        [&](auto& s) {
+            asio::async_write(s, asio::buffer(output), std::move(on_write));
+        },
+        stream);
+}
+
+void Connection::do_proxy() {
+    auto self{shared_from_this()};
+    auto& socket = std::visit(
+        [](auto& s) -> asio::ip::tcp::socket::lowest_layer_type& {
+            return s.lowest_layer();
+        },
+        stream);
+
+    asio::error_code err;
+    auto client_address = socket.remote_endpoint(err).address().to_string();
+
+    proxy.forward(
+        request, proxy_path, std::move(client_address), socket.get_executor(),
+        ProxySink{
+            .write =
+                [this, self](std::string_view chunk,
+                             std::function<void(bool)> done) {
+                    std::visit(
+                        [&](auto& s) {
+                            asio::async_write(
+                                s, asio::buffer(chunk),
+                                [done = std::move(done)](
+                                    asio::error_code err, std::size_t) {
+                                    done(!err);
+                                });
+                        },
+                        stream);
+                },
+            .finish = [this, self]() { do_shutdown(); },
+        });
+}
+
+void Connection::set_cork(bool enabled) {
+    using cork = asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_CORK>;
+    asio::error_code err;
+    std::visit(
+        [&](auto& s) {
+            std::ignore = s.lowest_layer().set_option(cork{enabled}, err);
+        },
+        stream);
+}
+
+void Connection::do_shutdown() {
+    if (auto* socket = std::get_if<asio::ip::tcp::socket>(&stream)) {
+        asio::error_code err;
+        std::ignore = socket->shutdown(asio::ip::tcp::socket::shutdown_both, err);
+        connection_logger_v.info("Connection Closed");
+        return;
+    }
+
+    // send close_notify before closing the tcp connection, so clients can
+    // tell a complete response from a truncated one
+    auto self{shared_from_this()};
+    auto deadline = arm_deadline(tls_timeout);
+    std::get<TlsStream>(stream).async_shutdown(
+        [this, self, deadline](asio::error_code err) {
+            disarm_deadline(*deadline);
+            std::ignore = std::get<TlsStream>(stream).lowest_layer().shutdown(
+                asio::ip::tcp::socket::shutdown_both, err);
+            connection_logger_v.info("Connection Closed");
         });
 }
 
-} // namespace http
\ No newline at end of file
+} // namespace http
@@ -0,0 +1,45 @@
+#include "connection_manager.hpp"
+
+#include <algorithm>
+
+namespace http {
+
+void ConnectionManager::add(const ConnectionPtr& connection) {
+    std::lock_guard lock{mutex};
+    if (connections.size() >= prune_at) {
+        prune();
+        // amortized, a prune that frees little is not repeated right away
+        prune_at = std::max(prune_at, 2 * connections.size());
+    }
+    connections.push_back(connection);
+}
+
+void ConnectionManager::stop_all() {
+    std::vector<ConnectionPtr> open;
+    {
+        std::lock_guard lock{mutex};
+        for (const auto& connection : connections) {
+            if (auto ptr = connection.lock()) {
+                open.push_back(std::move(ptr));
+            }
+        }
+    }
+
+    for (const auto& connection : open) {
+        connection->stop();
+    }
+}
+
+std::size_t ConnectionManager::size() {
+    std::lock_guard lock{mutex};
+    prune();
+    return connections.size();
+}
+
+void ConnectionManager::prune() {
+    std::erase_if(connections, [](const auto& connection) {
+        return connection.expired();
+    });
+}
+
+} // namespace http
@@ -0,0 +1,212 @@
+#include "document_index.hpp"
+#include "file_descriptor.hpp"
+#include "mime_type.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <dirent.h>
+#include <fcntl.h>
+#include <format>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using http::FileDescriptor;
+using http::IndexedFile;
+
+// larger files are never preloaded, so a single one can't use up the budget
+constexpr std::size_t max_preload_size_v = 1024 * 1024;
+
+using Entry = std::pair<std::string, IndexedFile>;
+
+// state shared by the threads walking the document root
+struct Walk {
+    Walk(int root, std::size_t budget) : root{root}, budget{budget} {}
+
+    int root;
+    std::atomic<std::size_t> budget; // preload bytes left
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    // directories left to walk, relative to root. A walker that is busy may
+    // still add more, so the walk is only done once none is
+    std::vector<std::string> pending{""};
+    std::size_t walking = 0;
+};
+
+// claim size bytes of the preload budget
+bool reserve(std::atomic<std::size_t>& budget, std::size_t size) {
+    auto left = budget.load(std::memory_order_relaxed);
+    while (left >= size) {
+        if (budget.compare_exchange_weak(left, left - size,
+                                         std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void preload(Walk& walk, int directory, const char* name, IndexedFile& file) {
+    if (file.size > max_preload_size_v || !reserve(walk.budget, file.size)) {
+        return;
+    }
+
+    // non-blocking in case the file was replaced by a fifo since the walk
+    // looked at it
+    auto fd = FileDescriptor{
+        ::openat(directory, name,
+                 O_RDONLY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC)};
+    file.content = std::string(file.size, '\0');
+    if (fd && http::read_all(fd.get(), file.content)) {
+        file.preloaded = true;
+        return;
+    }
+
+    file.content = {};
+    walk.budget += file.size;
+}
+
+void walk_directory(Walk& walk, const std::string& directory,
+                    std::vector<Entry>& found,
+                    std::vector<std::string>& subdirectories) {
+    auto fd = FileDescriptor{::openat(
+        walk.root, directory.empty() ? "." : directory.c_str(),
+        O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC)};
+    auto* stream = fd ? ::fdopendir(fd.get()) : nullptr;
+    if (!stream) {
+        return;
+    }
+    const auto dir = fd.release(); // closed along with the stream
+
+    while (const auto* entry = ::readdir(stream)) {
+        const std::string_view name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+
+        struct stat info{};
+        if (::fstatat(dir, entry->d_name, &info, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+
+        auto path = directory;
+        if (!path.empty()) {
+            path.push_back('/');
+        }
+        path.append(name);
+
+        if (S_ISDIR(info.st_mode)) {
+            subdirectories.push_back(std::move(path));
+            continue;
+        }
+        if (!S_ISREG(info.st_mode)) { // symlinks, devices, fifos...
+            continue;
+        }
+
+        path.insert(path.begin(), '/');
+        IndexedFile file{
+            .size = static_cast<std::size_t>(info.st_size),
+            .modified = info.st_mtime,
+            .etag = http::to_etag(info.st_size, info.st_mtime),
+            .mime_type = http::to_mime_type(path),
+        };
+        preload(walk, dir, entry->d_name, file);
+        found.emplace_back(std::move(path), std::move(file));
+    }
+
+    ::closedir(stream);
+}
+
+void walker(Walk& walk, std::vector<Entry>& found) {
+    std::vector<std::string> subdirectories;
+    std::unique_lock lock{walk.mutex};
+    while (true) {
+        walk.changed.wait(lock, [&walk]() {
+            return !walk.pending.empty() || walk.walking == 0;
+        });
+        if (walk.pending.empty()) {
+            return; // nothing left, and no walker can find more
+        }
+
+        auto directory = std::move(walk.pending.back());
+        walk.pending.pop_back();
+        ++walk.walking;
+        lock.unlock();
+
+        walk_directory(walk, directory, found, subdirectories);
+
+        lock.lock();
+        --walk.walking;
+        for (auto& subdirectory : subdirectories) {
+            walk.pending.push_back(std::move(subdirectory));
+        }
+        subdirectories.clear();
+        walk.changed.notify_all();
+    }
+}
+
+// heap memory owned by a string, nothing while it fits the small buffer
+std::size_t heap_size(const std::string& str) {
+    return str.capacity() > std::string{}.capacity() ? str.capacity() + 1 : 0;
+}
+
+} // namespace
+
+namespace http {
+
+std::string to_etag(std::size_t size, std::time_t modified) {
+    return std::format("\"{:x}-{:x}\"", modified, size);
+}
+
+std::shared_ptr<const DocumentIndex>
+DocumentIndex::build(int root, const WarmUpOptions& options) {
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto threads =
+        options.threads > 0
+            ? options.threads
+            : std::max(1u, std::thread::hardware_concurrency());
+    auto walk = Walk{root, options.preload_budget};
+    auto found = std::vector<std::vector<Entry>>(threads);
+    {
+        std::vector<std::jthread> walkers;
+        for (auto i = 0uz; i < threads; ++i) {
+            walkers.emplace_back(
+                [&walk, &found = found[i]]() { walker(walk, found); });
+        }
+    }
+
+    auto index = std::make_shared<DocumentIndex>();
+    auto& stats = index->statistics;
+    for (auto& entries : found) {
+        for (auto& [path, file] : entries) {
+            stats.files += 1;
+            stats.preloaded_files += file.preloaded ? 1 : 0;
+            stats.preloaded_bytes += file.content.size();
+            index->files.emplace(std::move(path), std::move(file));
+        }
+    }
+
+    // nodes of the map hold a hash and a next pointer besides the entry
+    stats.memory = index->files.bucket_count() * sizeof(void*);
+    for (const auto& [path, file] : index->files) {
+        stats.memory += sizeof(std::pair<const std::string, IndexedFile>) +
+                        2 * sizeof(void*) + heap_size(path) +
+                        heap_size(file.etag) + heap_size(file.content);
+    }
+    stats.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    return index;
+}
+
+const IndexedFile* DocumentIndex::find(std::string_view path) const {
+    auto it = files.find(path);
+    return it != files.end() ? &it->second : nullptr;
+}
+
+} // namespace http
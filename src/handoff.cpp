@@ -0,0 +1,117 @@
+#include "handoff.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// a message has to carry at least a byte for its control data to arrive
+constexpr char handoff_byte_v = 'L';
+
+union ControlBuffer {
+    char buffer[CMSG_SPACE(sizeof(int))];
+    cmsghdr align;
+};
+
+} // namespace
+
+namespace http {
+
+FileDescriptor receive_listener(const std::string& path,
+                                std::chrono::milliseconds timeout) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        return {};
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // a peer that accepts and then never answers mustn't keep the new
+    // server from starting, so connecting and receiving are both bounded
+    const auto seconds = std::chrono::floor<std::chrono::seconds>(timeout);
+    const auto deadline = timeval{
+        .tv_sec = static_cast<time_t>(seconds.count()),
+        .tv_usec = static_cast<suseconds_t>(
+            std::chrono::microseconds{timeout - seconds}.count()),
+    };
+
+    auto socket =
+        FileDescriptor{::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+    if (!socket ||
+        ::setsockopt(socket.get(), SOL_SOCKET, SO_SNDTIMEO, &deadline,
+                     sizeof(deadline)) != 0 ||
+        ::setsockopt(socket.get(), SOL_SOCKET, SO_RCVTIMEO, &deadline,
+                     sizeof(deadline)) != 0 ||
+        ::connect(socket.get(), reinterpret_cast<const sockaddr*>(&address),
+                  sizeof(address)) != 0) {
+        return {}; // nobody to take over from
+    }
+    if (!is_same_user(socket.get())) {
+        return {};
+    }
+
+    char byte = 0;
+    iovec data{.iov_base = &byte, .iov_len = 1};
+    ControlBuffer control{};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    ssize_t n = 0;
+    do { // fails with EAGAIN once the timeout expires
+        n = ::recvmsg(socket.get(), &message, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n != 1 || byte != handoff_byte_v) {
+        return {};
+    }
+
+    const auto* header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_level != SOL_SOCKET ||
+        header->cmsg_type != SCM_RIGHTS ||
+        header->cmsg_len != CMSG_LEN(sizeof(int))) {
+        return {};
+    }
+
+    int listener = -1;
+    std::memcpy(&listener, CMSG_DATA(header), sizeof(listener));
+    return FileDescriptor{listener};
+}
+
+bool send_listener(int socket, int listener) {
+    char byte = handoff_byte_v;
+    iovec data{.iov_base = &byte, .iov_len = 1};
+    ControlBuffer control{};
+    msghdr message{};
+    message.msg_iov = &data;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    auto* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(header), &listener, sizeof(listener));
+
+    ssize_t n = 0;
+    do {
+        n = ::sendmsg(socket, &message, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n == 1;
+}
+
+bool is_same_user(int socket) {
+    ucred credentials{};
+    socklen_t length = sizeof(credentials);
+    return ::getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials,
+                        &length) == 0 &&
+           credentials.uid == ::geteuid();
+}
+
+} // namespace http
@@ -0,0 +1,170 @@
+#include "headers.hpp"
+
+#include <algorithm>
+
+namespace {
+
+using http::KnownHeader;
+
+constexpr auto names_v =
+    std::array<std::string_view, http::known_header_count_v>{
+        "Accept",
+        "Accept-Encoding",
+        "Accept-Language",
+        "Authorization",
+        "Cache-Control",
+        "Connection",
+        "Content-Length",
+        "Content-Type",
+        "Cookie",
+        "Expect",
+        "Forwarded",
+        "Host",
+        "If-Match",
+        "If-Modified-Since",
+        "If-None-Match",
+        "If-Range",
+        "If-Unmodified-Since",
+        "Keep-Alive",
+        "Origin",
+        "Proxy-Connection",
+        "Range",
+        "Referer",
+        "TE",
+        "Transfer-Encoding",
+        "Upgrade",
+        "User-Agent",
+        "X-Forwarded-For",
+        "X-Forwarded-Proto",
+    };
+
+constexpr char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// FNV-1a over the lowercased name. It is seeded, so that a seed mapping every
+// known name to a different slot can be searched for at compile time
+constexpr std::uint32_t hash(std::string_view name, std::uint32_t seed) {
+    auto h = 2166136261u ^ seed;
+    for (char c : name) {
+        h ^= static_cast<unsigned char>(to_lower(c));
+        h *= 16777619u;
+    }
+    return h;
+}
+
+constexpr std::size_t slots_v = 128;
+
+consteval std::uint32_t find_seed() {
+    for (std::uint32_t seed = 0;; ++seed) {
+        std::array<bool, slots_v> used{};
+        auto collides = false;
+        for (auto name : names_v) {
+            auto& slot = used[hash(name, seed) % slots_v];
+            collides = collides || slot;
+            slot = true;
+        }
+        if (!collides) {
+            return seed;
+        }
+    }
+}
+
+constexpr auto seed_v = find_seed();
+
+// 1 + the KnownHeader a slot belongs to, 0 if no known name hashes to it
+constexpr auto slot_table_v = [] {
+    std::array<std::uint8_t, slots_v> table{};
+    for (auto i = 0uz; i < names_v.size(); ++i) {
+        table[hash(names_v[i], seed_v) % slots_v] =
+            static_cast<std::uint8_t>(i + 1);
+    }
+    return table;
+}();
+
+std::string_view separator(KnownHeader header) {
+    // cookies are the one field that is joined differently (RFC 9113 8.2.3)
+    return header == KnownHeader::Cookie ? "; " : ", ";
+}
+
+} // namespace
+
+namespace http {
+
+std::string_view to_string(KnownHeader header) {
+    return names_v[static_cast<std::size_t>(header)];
+}
+
+std::optional<KnownHeader> to_known_header(std::string_view name) {
+    const auto entry = slot_table_v[hash(name, seed_v) % slots_v];
+    if (entry == 0 || !iequals(name, names_v[entry - 1])) {
+        return {};
+    }
+    return static_cast<KnownHeader>(entry - 1);
+}
+
+bool iequals(std::string_view lhs, std::string_view rhs) {
+    return std::ranges::equal(lhs, rhs, [](char a, char b) {
+        return to_lower(a) == to_lower(b);
+    });
+}
+
+void Headers::add(std::string_view name, std::string_view value) {
+    if (auto header = to_known_header(name)) {
+        add(*header, value);
+        return;
+    }
+
+    auto it = std::ranges::find_if(
+        other, [name](const Header& h) { return iequals(h.name, name); });
+    if (it == other.end()) {
+        other.push_back({std::string{name}, std::string{value}});
+        return;
+    }
+    it->value.append(", ");
+    it->value.append(value);
+}
+
+void Headers::add(KnownHeader header, std::string_view value) {
+    const auto i = static_cast<std::size_t>(header);
+    if (present.test(i)) {
+        known[i].append(separator(header));
+        known[i].append(value);
+        return;
+    }
+    known[i].assign(value);
+    present.set(i);
+}
+
+std::optional<std::string_view> Headers::get(KnownHeader header) const {
+    const auto i = static_cast<std::size_t>(header);
+    if (!present.test(i)) {
+        return {};
+    }
+    return known[i];
+}
+
+std::optional<std::string_view> Headers::get(std::string_view name) const {
+    if (auto header = to_known_header(name)) {
+        return get(*header);
+    }
+
+    auto it = std::ranges::find_if(
+        other, [name](const Header& h) { return iequals(h.name, name); });
+    if (it == other.end()) {
+        return {};
+    }
+    return it->value;
+}
+
+void Headers::clear() {
+    for (auto i = 0uz; i < known_header_count_v; ++i) {
+        if (present.test(i)) {
+            known[i].clear();
+        }
+    }
+    present.reset();
+    other.clear();
+}
+
+} // namespace http
@@ -0,0 +1,456 @@
+#include "hpack.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace http::hpack {
+
+namespace {
+
+using Field = Table::Field;
+
+// RFC 7541 Appendix A
+constexpr auto static_table_v = std::array{
+    Field{":authority", ""},
+    Field{":method", "GET"},
+    Field{":method", "POST"},
+    Field{":path", "/"},
+    Field{":path", "/index.html"},
+    Field{":scheme", "http"},
+    Field{":scheme", "https"},
+    Field{":status", "200"},
+    Field{":status", "204"},
+    Field{":status", "206"},
+    Field{":status", "304"},
+    Field{":status", "400"},
+    Field{":status", "404"},
+    Field{":status", "500"},
+    Field{"accept-charset", ""},
+    Field{"accept-encoding", "gzip, deflate"},
+    Field{"accept-language", ""},
+    Field{"accept-ranges", ""},
+    Field{"accept", ""},
+    Field{"access-control-allow-origin", ""},
+    Field{"age", ""},
+    Field{"allow", ""},
+    Field{"authorization", ""},
+    Field{"cache-control", ""},
+    Field{"content-disposition", ""},
+    Field{"content-encoding", ""},
+    Field{"content-language", ""},
+    Field{"content-length", ""},
+    Field{"content-location", ""},
+    Field{"content-range", ""},
+    Field{"content-type", ""},
+    Field{"cookie", ""},
+    Field{"date", ""},
+    Field{"etag", ""},
+    Field{"expect", ""},
+    Field{"expires", ""},
+    Field{"from", ""},
+    Field{"host", ""},
+    Field{"if-match", ""},
+    Field{"if-modified-since", ""},
+    Field{"if-none-match", ""},
+    Field{"if-range", ""},
+    Field{"if-unmodified-since", ""},
+    Field{"last-modified", ""},
+    Field{"link", ""},
+    Field{"location", ""},
+    Field{"max-forwards", ""},
+    Field{"proxy-authenticate", ""},
+    Field{"proxy-authorization", ""},
+    Field{"range", ""},
+    Field{"referer", ""},
+    Field{"refresh", ""},
+    Field{"retry-after", ""},
+    Field{"server", ""},
+    Field{"set-cookie", ""},
+    Field{"strict-transport-security", ""},
+    Field{"transfer-encoding", ""},
+    Field{"user-agent", ""},
+    Field{"vary", ""},
+    Field{"via", ""},
+    Field{"www-authenticate", ""},
+};
+
+// overhead added to the length of name and value of every table entry
+constexpr std::size_t entry_overhead_v = 32;
+
+// fields whose values rarely repeat, so adding them to the dynamic table
+// would only evict useful entries
+constexpr auto unindexed_names_v = std::array<std::string_view, 6>{
+    "content-length", "date", "etag", "last-modified", "location", "set-cookie",
+};
+
+struct HuffmanCode {
+    std::uint32_t code;
+    std::uint8_t bits;
+};
+
+// RFC 7541 Appendix B, indexed by symbol; 256 is EOS
+constexpr auto huffman_codes_v = std::array<HuffmanCode, 257>{{
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12}, {0x1ff9, 13}, {0x15, 6},
+    {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6}, {0x0, 5}, {0x1, 5}, {0x2, 5},
+    {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6},
+    {0x5c, 7}, {0xfb, 8}, {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7},
+    {0x61, 7}, {0x62, 7}, {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7},
+    {0x68, 7}, {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7}, {0xfd, 8},
+    {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6},
+    {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7}, {0x28, 6}, {0x29, 6},
+    {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5}, {0x9, 5},
+    {0x2d, 6}, {0x77, 7}, {0x78, 7}, {0x79, 7}, {0x7a, 7}, {0x7b, 7},
+    {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22},
+    {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22},
+    {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23},
+    {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23}, {0xffffec, 24},
+    {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24},
+    {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23},
+    {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23}, {0x3fffd9, 22},
+    {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22},
+    {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22},
+    {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21}, {0x7fffea, 23},
+    {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21},
+    {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21},
+    {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23},
+    {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20},
+    {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23},
+    {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23}, {0x3ffffe0, 26},
+    {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22},
+    {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26},
+    {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27}, {0x7ffffdf, 27},
+    {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19},
+    {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27},
+    {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24}, {0x1fffe4, 21},
+    {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28},
+    {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20},
+    {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21}, {0x3fffe9, 22},
+    {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22},
+    {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24},
+    {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23}, {0x3ffffeb, 26},
+    {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27},
+    {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27},
+    {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27}, {0x7ffffee, 27},
+    {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+}};
+
+// Binary tree over huffman_codes_v used for decoding one bit at a time.
+// Children are node indices, or leaves holding -(symbol + 1)
+struct HuffmanTree {
+    std::vector<std::array<std::int16_t, 2>> nodes;
+
+    HuffmanTree() {
+        nodes.push_back({});
+        for (auto symbol = 0uz; symbol < huffman_codes_v.size(); ++symbol) {
+            const auto [code, bits] = huffman_codes_v[symbol];
+            auto node = 0uz;
+            for (auto i = bits; i-- > 1;) {
+                const auto bit = (code >> i) & 1;
+                if (nodes[node][bit] == 0) {
+                    nodes[node][bit] = static_cast<std::int16_t>(nodes.size());
+                    nodes.push_back({});
+                }
+                node = static_cast<std::size_t>(nodes[node][bit]);
+            }
+            nodes[node][code & 1] = static_cast<std::int16_t>(-(symbol + 1));
+        }
+    }
+};
+
+bool huffman_decode(std::string_view input, std::string& out) {
+    static const HuffmanTree tree;
+    constexpr std::int16_t eos_v = -257;
+
+    auto node = 0;
+    auto padding_bits = 0;   // bits read since the last complete symbol
+    auto padding_ones = true; // padding has to be a prefix of EOS (all 1s)
+    for (unsigned char byte : input) {
+        for (auto i = 8; i-- > 0;) {
+            const auto bit = (byte >> i) & 1;
+            const auto next = tree.nodes[node][bit];
+            ++padding_bits;
+            padding_ones = padding_ones && bit;
+            if (next == eos_v) {
+                return false;
+            }
+            if (next < 0) {
+                out.push_back(static_cast<char>(-next - 1));
+                node = 0;
+                padding_bits = 0;
+                padding_ones = true;
+            } else {
+                node = next;
+            }
+        }
+    }
+
+    return padding_bits <= 7 && padding_ones;
+}
+
+// integer with an N-bit prefix, RFC 7541 5.1
+bool decode_integer(std::string_view& input, int prefix_bits,
+                    std::size_t& value) {
+    if (input.empty()) {
+        return false;
+    }
+
+    const auto mask = (1u << prefix_bits) - 1;
+    value = static_cast<unsigned char>(input[0]) & mask;
+    input.remove_prefix(1);
+    if (value < mask) {
+        return true;
+    }
+
+    for (auto shift = 0; !input.empty(); shift += 7) {
+        if (shift > 28) { // more than fits any sane length or index
+            return false;
+        }
+        const auto byte = static_cast<unsigned char>(input[0]);
+        input.remove_prefix(1);
+        value += static_cast<std::size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void encode_integer(std::size_t value, int prefix_bits, std::uint8_t flags,
+                    std::string& out) {
+    const auto mask = (1u << prefix_bits) - 1;
+    if (value < mask) {
+        out.push_back(static_cast<char>(flags | value));
+        return;
+    }
+
+    out.push_back(static_cast<char>(flags | mask));
+    value -= mask;
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// string literal, RFC 7541 5.2
+bool decode_string(std::string_view& input, std::string& out) {
+    if (input.empty()) {
+        return false;
+    }
+
+    const bool huffman = static_cast<unsigned char>(input[0]) & 0x80;
+    std::size_t length = 0;
+    if (!decode_integer(input, 7, length) || length > input.size()) {
+        return false;
+    }
+
+    const auto literal = input.substr(0, length);
+    input.remove_prefix(length);
+    if (huffman) {
+        return huffman_decode(literal, out);
+    }
+    out.append(literal);
+    return true;
+}
+
+void encode_string(std::string_view str, std::string& out) {
+    encode_integer(str.size(), 7, 0x00, out);
+    out.append(str);
+}
+
+} // namespace
+
+Table::Table(std::size_t max_size) : max_size{max_size} {}
+
+auto Table::at(std::size_t index) const -> std::optional<Field> {
+    if (index == 0) {
+        return {};
+    }
+    if (index <= static_table_v.size()) {
+        return static_table_v[index - 1];
+    }
+
+    index -= static_table_v.size() + 1;
+    if (index >= entries.size()) {
+        return {};
+    }
+    return Field{entries[index].name, entries[index].value};
+}
+
+auto Table::find(std::string_view name, std::string_view value) const
+    -> Match {
+    Match match;
+    for (auto i = 0uz; i < static_table_v.size(); ++i) {
+        if (static_table_v[i].name != name) {
+            continue;
+        }
+        if (static_table_v[i].value == value) {
+            return {i + 1, true};
+        }
+        if (match.index == 0) {
+            match.index = i + 1;
+        }
+    }
+
+    for (auto i = 0uz; i < entries.size(); ++i) {
+        if (entries[i].name != name) {
+            continue;
+        }
+        if (entries[i].value == value) {
+            return {static_table_v.size() + i + 1, true};
+        }
+        if (match.index == 0) {
+            match.index = static_table_v.size() + i + 1;
+        }
+    }
+    return match;
+}
+
+void Table::insert(std::string_view name, std::string_view value) {
+    const auto entry_size = name.size() + value.size() + entry_overhead_v;
+    if (entry_size > max_size) { // empties the table, RFC 7541 4.4
+        evict_to(0);
+        return;
+    }
+
+    evict_to(max_size - entry_size);
+    entries.push_front(Header{std::string{name}, std::string{value}});
+    size += entry_size;
+}
+
+void Table::set_max_size(std::size_t new_max_size) {
+    max_size = new_max_size;
+    evict_to(max_size);
+}
+
+void Table::evict_to(std::size_t target_size) {
+    while (size > target_size && !entries.empty()) {
+        const auto& oldest = entries.back();
+        size -= oldest.name.size() + oldest.value.size() + entry_overhead_v;
+        entries.pop_back();
+    }
+}
+
+Decoder::Decoder(std::size_t max_table_size, std::size_t max_list_size)
+    : table{max_table_size}, max_table_size{max_table_size},
+      max_list_size{max_list_size} {}
+
+bool Decoder::decode(std::string_view block, std::vector<Header>& headers) {
+    auto list_size = 0uz;
+    auto first_field = true;
+
+    while (!block.empty()) {
+        const auto byte = static_cast<unsigned char>(block[0]);
+
+        if ((byte & 0xe0) == 0x20) { // dynamic table size update
+            std::size_t size = 0;
+            if (!first_field || !decode_integer(block, 5, size) ||
+                size > max_table_size) {
+                return false;
+            }
+            table.set_max_size(size);
+            continue;
+        }
+        first_field = false;
+
+        Header header;
+        if (byte & 0x80) { // indexed field
+            std::size_t index = 0;
+            if (!decode_integer(block, 7, index)) {
+                return false;
+            }
+            auto field = table.at(index);
+            if (!field) {
+                return false;
+            }
+            header = {std::string{field->name}, std::string{field->value}};
+        } else {
+            // literal field, with incremental indexing (01), never indexed
+            // (0001) or without indexing (0000)
+            const bool indexing = byte & 0x40;
+            std::size_t name_index = 0;
+            if (!decode_integer(block, indexing ? 6 : 4, name_index)) {
+                return false;
+            }
+
+            if (name_index != 0) {
+                auto field = table.at(name_index);
+                if (!field) {
+                    return false;
+                }
+                header.name = field->name;
+            } else if (!decode_string(block, header.name)) {
+                return false;
+            }
+            if (!decode_string(block, header.value)) {
+                return false;
+            }
+
+            if (indexing) {
+                table.insert(header.name, header.value);
+            }
+        }
+
+        list_size += header.name.size() + header.value.size() + entry_overhead_v;
+        if (list_size > max_list_size) {
+            return false;
+        }
+        headers.push_back(std::move(header));
+    }
+
+    return true;
+}
+
+void Encoder::begin_block(std::string& out) {
+    if (pending_size_update) {
+        table.set_max_size(*pending_size_update);
+        encode_integer(*pending_size_update, 5, 0x20, out);
+        pending_size_update.reset();
+    }
+}
+
+void Encoder::encode(std::string_view name, std::string_view value,
+                     std::string& out) {
+    const auto match = table.find(name, value);
+    if (match.exact) {
+        encode_integer(match.index, 7, 0x80, out);
+        return;
+    }
+
+    const bool indexing =
+        std::ranges::find(unindexed_names_v, name) == unindexed_names_v.end();
+    if (indexing) {
+        encode_integer(match.index, 6, 0x40, out);
+    } else {
+        encode_integer(match.index, 4, 0x00, out);
+    }
+    if (match.index == 0) {
+        encode_string(name, out);
+    }
+    encode_string(value, out);
+
+    if (indexing) {
+        table.insert(name, value);
+    }
+}
+
+void Encoder::set_max_table_size(std::size_t size) {
+    // never grow past the default, there's little to gain for responses
+    pending_size_update = std::min(size, default_table_size_v);
+}
+
+} // namespace http::hpack
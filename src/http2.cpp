@@ -0,0 +1,662 @@
+#include "http2.hpp"
+#include "proxy.hpp"
+#include "request_handler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <string>
+#include <utility>
+
+namespace http::http2 {
+
+namespace {
+
+constexpr std::size_t frame_header_size_v = 9;
+
+// limits advertised to and enforced on the peer
+constexpr std::uint32_t max_frame_size_v = 16384;
+constexpr std::uint32_t max_concurrent_streams_v = 100;
+constexpr std::uint32_t max_header_list_size_v = 64 * 1024;
+
+constexpr std::int64_t max_window_size_v = (1ll << 31) - 1;
+
+// DATA queued per next_output() call, so one large response can't make the
+// output buffer grow without bound
+constexpr std::size_t write_budget_v = 64 * 1024;
+
+// queued output past which the peer has to read before it's read from again
+constexpr std::size_t max_output_backlog_v = 128 * 1024;
+
+namespace flags {
+constexpr std::uint8_t end_stream = 0x1;
+constexpr std::uint8_t ack = 0x1;
+constexpr std::uint8_t end_headers = 0x4;
+constexpr std::uint8_t padded = 0x8;
+constexpr std::uint8_t priority = 0x20;
+} // namespace flags
+
+namespace settings {
+constexpr std::uint16_t header_table_size = 0x1;
+constexpr std::uint16_t enable_push = 0x2;
+constexpr std::uint16_t max_concurrent_streams = 0x3;
+constexpr std::uint16_t initial_window_size = 0x4;
+constexpr std::uint16_t max_frame_size = 0x5;
+constexpr std::uint16_t max_header_list_size = 0x6;
+} // namespace settings
+
+// connection specific fields, not allowed in HTTP/2 messages
+constexpr auto connection_fields_v = std::array<std::string_view, 5>{
+    "connection", "keep-alive", "proxy-connection", "transfer-encoding",
+    "upgrade",
+};
+
+std::uint32_t read_u32(std::string_view bytes) {
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[0]))
+               << 24 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[1]))
+               << 16 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[2]))
+               << 8 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[3]));
+}
+
+std::uint16_t read_u16(std::string_view bytes) {
+    return static_cast<std::uint16_t>(
+        static_cast<unsigned char>(bytes[0]) << 8 |
+        static_cast<unsigned char>(bytes[1]));
+}
+
+void append_u32(std::string& out, std::uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void append_u16(std::string& out, std::uint16_t value) {
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+// remove the padding of a PADDED frame, false if it's malformed
+bool strip_padding(std::uint8_t frame_flags, std::string_view& payload) {
+    if (!(frame_flags & flags::padded)) {
+        return true;
+    }
+    if (payload.empty()) {
+        return false;
+    }
+
+    const auto padding = static_cast<unsigned char>(payload[0]);
+    payload.remove_prefix(1);
+    if (padding > payload.size()) {
+        return false;
+    }
+    payload.remove_suffix(padding);
+    return true;
+}
+
+bool is_connection_field(std::string_view name) {
+    return std::ranges::find(connection_fields_v, name) !=
+           connection_fields_v.end();
+}
+
+} // namespace
+
+Session::Session(RequestHandler& handler, const ProxyHandler& proxy)
+    : handler{handler}, proxy{proxy} {
+    std::string payload;
+    append_u16(payload, settings::max_concurrent_streams);
+    append_u32(payload, max_concurrent_streams_v);
+    append_u16(payload, settings::max_header_list_size);
+    append_u32(payload, max_header_list_size_v);
+    queue_frame(FrameType::Settings, 0, 0, payload);
+}
+
+bool Session::consume(std::string_view data) {
+    if (failed) {
+        return false;
+    }
+
+    input.append(data);
+    std::string_view pending = input;
+
+    if (!preface_received) {
+        const auto n = std::min(pending.size(), client_preface_v.size());
+        if (pending.substr(0, n) != client_preface_v.substr(0, n)) {
+            return connection_error(ErrorCode::ProtocolError);
+        }
+        if (n < client_preface_v.size()) {
+            return true;
+        }
+        pending.remove_prefix(n);
+        preface_received = true;
+    }
+
+    while (pending.size() >= frame_header_size_v) {
+        Frame frame{
+            .length = read_u32(pending) >> 8,
+            .type = static_cast<FrameType>(pending[3]),
+            .flags = static_cast<std::uint8_t>(pending[4]),
+            .stream_id = read_u32(pending.substr(5)) & 0x7fffffff,
+        };
+        if (frame.length > max_frame_size_v) {
+            return connection_error(ErrorCode::FrameSizeError);
+        }
+        if (pending.size() < frame_header_size_v + frame.length) {
+            break;
+        }
+
+        frame.payload = pending.substr(frame_header_size_v, frame.length);
+        if (!on_frame(frame)) {
+            return false;
+        }
+        pending.remove_prefix(frame_header_size_v + frame.length);
+    }
+
+    input.erase(0, input.size() - pending.size());
+    return true;
+}
+
+std::string_view Session::next_output() {
+    if (writing.empty()) {
+        schedule_data();
+        std::swap(output, writing);
+    }
+    return writing;
+}
+
+void Session::output_written() { writing.clear(); }
+
+bool Session::backlogged() const {
+    return output.size() + writing.size() >= max_output_backlog_v;
+}
+
+void Session::go_away() {
+    if (going_away) {
+        return;
+    }
+    going_away = true;
+
+    std::string payload;
+    append_u32(payload, last_stream_id);
+    append_u32(payload, std::to_underlying(ErrorCode::NoError));
+    queue_frame(FrameType::GoAway, 0, 0, payload);
+}
+
+bool Session::finished() const {
+    return (failed || going_away) && streams.empty() && output.empty() &&
+           writing.empty();
+}
+
+bool Session::on_frame(const Frame& frame) {
+    // a header block has to be sent in one piece, RFC 9113 6.10
+    if (continuation_stream_id != 0 && frame.type != FrameType::Continuation) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+
+    // the client preface ends with a SETTINGS frame
+    if (!settings_received && frame.type != FrameType::Settings) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+
+    switch (frame.type) {
+    case FrameType::Data:
+        return on_data(frame);
+    case FrameType::Headers:
+        return on_headers(frame);
+    case FrameType::Priority:
+        return on_priority(frame);
+    case FrameType::RstStream:
+        return on_rst_stream(frame);
+    case FrameType::Settings:
+        return on_settings(frame);
+    case FrameType::PushPromise: // clients can't push
+        return connection_error(ErrorCode::ProtocolError);
+    case FrameType::Ping:
+        return on_ping(frame);
+    case FrameType::GoAway:
+        return on_goaway(frame);
+    case FrameType::WindowUpdate:
+        return on_window_update(frame);
+    case FrameType::Continuation:
+        return on_continuation(frame);
+    default: // unknown frame types are ignored
+        return true;
+    }
+}
+
+bool Session::on_data(const Frame& frame) {
+    auto payload = frame.payload;
+    if (frame.stream_id == 0 || !strip_padding(frame.flags, payload)) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+
+    // request bodies are discarded, so whatever was received counts against
+    // the connection window only until it's handed back here
+    if (frame.length > 0) {
+        queue_window_update(0, frame.length);
+    }
+
+    auto it = streams.find(frame.stream_id);
+    if (it == streams.end() || it->second.request_complete) {
+        if (frame.stream_id > last_stream_id) { // idle stream
+            return connection_error(ErrorCode::ProtocolError);
+        }
+        reset_stream(frame.stream_id, ErrorCode::StreamClosed);
+        return true;
+    }
+
+    auto& stream = it->second;
+    if (frame.flags & flags::end_stream) {
+        stream.request_complete = true;
+        respond(frame.stream_id, stream);
+    } else if (frame.length > 0) {
+        queue_window_update(frame.stream_id, frame.length);
+    }
+    return true;
+}
+
+bool Session::on_headers(const Frame& frame) {
+    auto payload = frame.payload;
+    if (frame.stream_id == 0 || !strip_padding(frame.flags, payload)) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+
+    header_block_weight = 16;
+    if (frame.flags & flags::priority) {
+        if (payload.size() < 5) {
+            return connection_error(ErrorCode::FrameSizeError);
+        }
+        if ((read_u32(payload) & 0x7fffffff) == frame.stream_id) {
+            return connection_error(ErrorCode::ProtocolError);
+        }
+        header_block_weight = static_cast<unsigned char>(payload[4]) + 1;
+        payload.remove_prefix(5);
+    }
+
+    header_block.assign(payload);
+    const bool end_stream = frame.flags & flags::end_stream;
+    if (!(frame.flags & flags::end_headers)) {
+        continuation_stream_id = frame.stream_id;
+        continuation_end_stream = end_stream;
+        return true;
+    }
+    return on_header_block(frame.stream_id, end_stream);
+}
+
+bool Session::on_continuation(const Frame& frame) {
+    if (continuation_stream_id == 0 ||
+        frame.stream_id != continuation_stream_id) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+
+    header_block.append(frame.payload);
+    if (header_block.size() > max_header_list_size_v) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+
+    if (!(frame.flags & flags::end_headers)) {
+        return true;
+    }
+    continuation_stream_id = 0;
+    return on_header_block(frame.stream_id, continuation_end_stream);
+}
+
+bool Session::on_priority(const Frame& frame) {
+    if (frame.stream_id == 0) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+    if (frame.length != 5) {
+        reset_stream(frame.stream_id, ErrorCode::FrameSizeError);
+        return true;
+    }
+    if ((read_u32(frame.payload) & 0x7fffffff) == frame.stream_id) {
+        reset_stream(frame.stream_id, ErrorCode::ProtocolError);
+        return true;
+    }
+
+    // only the weight is used for scheduling, dependencies are ignored
+    if (auto it = streams.find(frame.stream_id); it != streams.end()) {
+        it->second.weight = static_cast<unsigned char>(frame.payload[4]) + 1;
+    }
+    return true;
+}
+
+bool Session::on_rst_stream(const Frame& frame) {
+    if (frame.stream_id == 0 || frame.stream_id > last_stream_id) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+    if (frame.length != 4) {
+        return connection_error(ErrorCode::FrameSizeError);
+    }
+    streams.erase(frame.stream_id);
+    return true;
+}
+
+bool Session::on_settings(const Frame& frame) {
+    if (frame.stream_id != 0) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+    if (frame.flags & flags::ack) {
+        return frame.length == 0 ||
+               connection_error(ErrorCode::FrameSizeError);
+    }
+    if (frame.length % 6 != 0) {
+        return connection_error(ErrorCode::FrameSizeError);
+    }
+
+    for (auto payload = frame.payload; !payload.empty();
+         payload.remove_prefix(6)) {
+        const auto id = read_u16(payload);
+        const auto value = read_u32(payload.substr(2));
+        switch (id) {
+        case settings::header_table_size:
+            encoder.set_max_table_size(value);
+            break;
+        case settings::enable_push:
+            if (value > 1) {
+                return connection_error(ErrorCode::ProtocolError);
+            }
+            break;
+        case settings::initial_window_size: {
+            if (value > max_window_size_v) {
+                return connection_error(ErrorCode::FlowControlError);
+            }
+            // applies to every open stream retroactively, RFC 9113 6.9.2
+            const auto delta = value - peer_initial_window_size;
+            for (auto& [_, stream] : streams) {
+                stream.send_window += delta;
+                if (stream.send_window > max_window_size_v) {
+                    return connection_error(ErrorCode::FlowControlError);
+                }
+            }
+            peer_initial_window_size = value;
+            break;
+        }
+        case settings::max_frame_size:
+            if (value < 16384 || value > 16777215) {
+                return connection_error(ErrorCode::ProtocolError);
+            }
+            peer_max_frame_size = value;
+            break;
+        default: // everything else doesn't affect a server
+            break;
+        }
+    }
+
+    settings_received = true;
+    queue_frame(FrameType::Settings, flags::ack, 0);
+    return true;
+}
+
+bool Session::on_ping(const Frame& frame) {
+    if (frame.stream_id != 0) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+    if (frame.length != 8) {
+        return connection_error(ErrorCode::FrameSizeError);
+    }
+    if (!(frame.flags & flags::ack)) {
+        queue_frame(FrameType::Ping, flags::ack, 0, frame.payload);
+    }
+    return true;
+}
+
+bool Session::on_goaway(const Frame& frame) {
+    if (frame.stream_id != 0) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+    if (frame.length < 8) {
+        return connection_error(ErrorCode::FrameSizeError);
+    }
+    // finish the streams already open, but don't accept any new ones
+    going_away = true;
+    return true;
+}
+
+bool Session::on_window_update(const Frame& frame) {
+    if (frame.length != 4) {
+        return connection_error(ErrorCode::FrameSizeError);
+    }
+
+    const auto increment = read_u32(frame.payload) & 0x7fffffff;
+    if (frame.stream_id == 0) {
+        send_window += increment;
+        if (increment == 0 || send_window > max_window_size_v) {
+            return connection_error(increment == 0
+                                        ? ErrorCode::ProtocolError
+                                        : ErrorCode::FlowControlError);
+        }
+        return true;
+    }
+
+    auto it = streams.find(frame.stream_id);
+    if (it == streams.end()) { // stream is already closed, nothing to do
+        return true;
+    }
+
+    it->second.send_window += increment;
+    if (increment == 0) {
+        reset_stream(frame.stream_id, ErrorCode::ProtocolError);
+    } else if (it->second.send_window > max_window_size_v) {
+        reset_stream(frame.stream_id, ErrorCode::FlowControlError);
+    }
+    return true;
+}
+
+bool Session::on_header_block(std::uint32_t stream_id, bool end_stream) {
+    // decode even blocks that are going to be refused, the header table has
+    // to stay in sync with the peer
+    std::vector<Header> fields;
+    const bool decoded = decoder.decode(header_block, fields);
+    header_block.clear();
+    if (!decoded) {
+        return connection_error(ErrorCode::CompressionError);
+    }
+
+    if (auto it = streams.find(stream_id); it != streams.end()) {
+        // trailers, they have to end the request
+        if (it->second.request_complete || !end_stream) {
+            return connection_error(ErrorCode::ProtocolError);
+        }
+        it->second.request_complete = true;
+        respond(stream_id, it->second);
+        return true;
+    }
+
+    // new streams are opened by the client, with increasing odd ids
+    if (stream_id <= last_stream_id || stream_id % 2 == 0) {
+        return connection_error(ErrorCode::ProtocolError);
+    }
+    last_stream_id = stream_id;
+
+    if (going_away) {
+        return true;
+    }
+    if (streams.size() >= max_concurrent_streams_v) {
+        reset_stream(stream_id, ErrorCode::RefusedStream);
+        return true;
+    }
+
+    Request request;
+    request.version = {.major = 2, .minor = 0};
+
+    std::string_view authority;
+    auto has_scheme = false;
+    auto malformed = false;
+    for (auto& field : fields) {
+        if (field.name.starts_with(':')) {
+            // pseudo header fields come before regular fields
+            malformed |= !request.headers.empty();
+            if (field.name == ":method") {
+                request.method = std::move(field.value);
+            } else if (field.name == ":path") {
+                request.uri = std::move(field.value);
+            } else if (field.name == ":scheme") {
+                has_scheme = true;
+            } else if (field.name == ":authority") {
+                authority = field.value;
+            } else {
+                malformed = true;
+            }
+            continue;
+        }
+
+        malformed |= std::ranges::any_of(
+            field.name, [](char c) { return c >= 'A' && c <= 'Z'; });
+        malformed |= is_connection_field(field.name);
+        request.headers.add(field.name, field.value);
+    }
+
+    if (malformed || !has_scheme || request.method.empty() ||
+        request.uri.empty()) {
+        reset_stream(stream_id, ErrorCode::ProtocolError);
+        return true;
+    }
+    if (!authority.empty() && !request.headers.contains(KnownHeader::Host)) {
+        request.headers.add(KnownHeader::Host, authority);
+    }
+    if (std::string path; proxy.matches(request, path)) {
+        reset_stream(stream_id, ErrorCode::Http11Required);
+        return true;
+    }
+
+    auto& stream = streams[stream_id];
+    stream.send_window = peer_initial_window_size;
+    stream.weight = header_block_weight;
+    stream.pass = virtual_time;
+    stream.request = std::move(request);
+    if (end_stream) {
+        stream.request_complete = true;
+        respond(stream_id, stream);
+    }
+    return true;
+}
+
+void Session::respond(std::uint32_t stream_id, Stream& stream) {
+    stream.response = handler.handle(stream.request);
+
+    // stock responses are only kept in serialized HTTP/1.0 form
+    const auto& response = stream.response.serialized.empty()
+                               ? stream.response
+                               : Response::stock(stream.response.status);
+    stream.body = response.body();
+
+    std::string block;
+    encoder.begin_block(block);
+    encoder.encode(":status",
+                   std::to_string(std::to_underlying(response.status)), block);
+    std::string name;
+    for (const auto& header : response.headers) {
+        name = header.name;
+        std::ranges::transform(name, name.begin(), [](unsigned char c) {
+            return static_cast<char>(std::tolower(c));
+        });
+        if (!is_connection_field(name)) {
+            encoder.encode(name, header.value, block);
+        }
+    }
+    if (response.date) {
+        encoder.encode("date", *response.date, block);
+    }
+
+    const bool end_stream = stream.body.empty();
+    auto type = FrameType::Headers;
+    std::string_view rest = block;
+    do {
+        const auto fragment = rest.substr(0, peer_max_frame_size);
+        rest.remove_prefix(fragment.size());
+
+        std::uint8_t frame_flags = rest.empty() ? flags::end_headers : 0;
+        if (type == FrameType::Headers && end_stream) {
+            frame_flags |= flags::end_stream;
+        }
+        queue_frame(type, frame_flags, stream_id, fragment);
+        type = FrameType::Continuation;
+    } while (!rest.empty());
+
+    if (end_stream) {
+        streams.erase(stream_id);
+    } else {
+        stream.responding = true;
+    }
+}
+
+void Session::schedule_data() {
+    // Weighted fair queuing: each DATA frame advances its stream's virtual
+    // time inversely to the stream's weight, and the stream furthest behind
+    // is served next
+    while (output.size() < write_budget_v && send_window > 0) {
+        auto next = streams.end();
+        for (auto it = streams.begin(); it != streams.end(); ++it) {
+            const auto& stream = it->second;
+            if (stream.responding && !stream.body.empty() &&
+                stream.send_window > 0 &&
+                (next == streams.end() || stream.pass < next->second.pass)) {
+                next = it;
+            }
+        }
+        if (next == streams.end()) {
+            return;
+        }
+
+        auto& [stream_id, stream] = *next;
+        const auto size = static_cast<std::size_t>(std::min<std::int64_t>(
+            {static_cast<std::int64_t>(stream.body.size()),
+             peer_max_frame_size, send_window, stream.send_window}));
+
+        const auto data = stream.body.substr(0, size);
+        stream.body.remove_prefix(size);
+        stream.send_window -= size;
+        send_window -= size;
+
+        virtual_time = stream.pass;
+        stream.pass += std::max<std::uint64_t>(1, size * 256 / stream.weight);
+
+        const bool end_stream = stream.body.empty();
+        queue_frame(FrameType::Data, end_stream ? flags::end_stream : 0,
+                    stream_id, data);
+        if (end_stream) {
+            streams.erase(next);
+        }
+    }
+}
+
+void Session::queue_frame(FrameType type, std::uint8_t frame_flags,
+                          std::uint32_t stream_id, std::string_view payload) {
+    append_u32(output, static_cast<std::uint32_t>(payload.size()) << 8 |
+                           std::to_underlying(type));
+    output.push_back(static_cast<char>(frame_flags));
+    append_u32(output, stream_id);
+    output.append(payload);
+}
+
+void Session::queue_window_update(std::uint32_t stream_id,
+                                  std::uint32_t increment) {
+    std::string payload;
+    append_u32(payload, increment);
+    queue_frame(FrameType::WindowUpdate, 0, stream_id, payload);
+}
+
+void Session::reset_stream(std::uint32_t stream_id, ErrorCode code) {
+    std::string payload;
+    append_u32(payload, std::to_underlying(code));
+    queue_frame(FrameType::RstStream, 0, stream_id, payload);
+    streams.erase(stream_id);
+}
+
+bool Session::connection_error(ErrorCode code) {
+    failed = true;
+    going_away = true;
+    streams.clear();
+
+    std::string payload;
+    append_u32(payload, last_stream_id);
+    append_u32(payload, std::to_underlying(code));
+    queue_frame(FrameType::GoAway, 0, 0, payload);
+    return false;
+}
+
+} // namespace http::http2
@@ -1,32 +1,178 @@
 #include "server.hpp"
 #include <cx/logger.hpp>
 
+#include <charconv>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view usage_v =
+    "usage: server <address> <port> <document-root> <threads> "
+    "[<certificate-chain> <private-key>]\n"
+    "              [--balance round-robin|least-connections] "
+    "[--proxy <prefix>=<host:port>[,<host:port>...]]...\n"
+    "              [--sndbuf <bytes>] [--defer-accept <seconds>] "
+    "[--fastopen <queue>]\n"
+    "              [--coalesce <bytes>] [--no-nodelay] "
+    "[--max-header-size <bytes>]\n"
+    "              [--drain-timeout <seconds>] [--handoff <socket-path>]\n"
+    "              [--warm-up] [--preload <bytes>]";
+
+// parse a non-negative integer option value
+std::optional<int> parse_count(std::string_view value) {
+    int count = 0;
+    const auto [end, err] =
+        std::from_chars(value.data(), value.data() + value.size(), count);
+    if (err != std::errc{} || end != value.data() + value.size() ||
+        count < 0) {
+        return {};
+    }
+    return count;
+}
+
+// parse "<prefix>=<host:port>[,<host:port>...]"
+std::optional<http::ProxyRoute>
+parse_proxy_route(std::string_view spec,
+                  http::ProxyRoute::Balancing balancing) {
+    const auto equals = spec.find('=');
+    if (equals == spec.npos || equals == 0) {
+        return {};
+    }
+
+    http::ProxyRoute route{
+        .prefix = std::string{spec.substr(0, equals)},
+        .balancing = balancing,
+    };
+    auto upstreams = spec.substr(equals + 1);
+    while (!upstreams.empty()) {
+        const auto comma = upstreams.find(',');
+        const auto upstream = upstreams.substr(0, comma);
+        const auto colon = upstream.rfind(':');
+        if (colon == upstream.npos || colon == 0 ||
+            colon + 1 == upstream.size()) {
+            return {};
+        }
+        route.upstreams.push_back({
+            .host = std::string{upstream.substr(0, colon)},
+            .port = std::string{upstream.substr(colon + 1)},
+        });
+        upstreams.remove_prefix(comma == upstreams.npos ? upstreams.size()
+                                                        : comma + 1);
+    }
+
+    if (route.upstreams.empty()) {
+        return {};
+    }
+    return route;
+}
+
+} // namespace
 
 int main(int argc, char* argv[]) {
-    if (argc != 5) {
-        std::println(
-            "usage: server <address> <port> <document-root> <threads>");
+    std::vector<std::string_view> args;
+    std::vector<http::ProxyRoute> proxy_routes;
+    auto balancing = http::ProxyRoute::Balancing::RoundRobin;
+    auto socket_options = http::SocketOptions{};
+    auto connection_options = http::ConnectionOptions{};
+    auto lifecycle_options = http::LifecycleOptions{};
+    auto warm_up = http::WarmUpOptions{};
+    for (auto i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if ((arg == "--sndbuf" || arg == "--defer-accept" ||
+             arg == "--fastopen" || arg == "--coalesce" ||
+             arg == "--max-header-size" || arg == "--drain-timeout" ||
+             arg == "--preload") &&
+            i + 1 < argc) {
+            const auto value = parse_count(argv[++i]);
+            if (!value) {
+                std::println("{}", usage_v);
+                return 1;
+            }
+            if (arg == "--sndbuf") {
+                socket_options.send_buffer_size = *value;
+            } else if (arg == "--defer-accept") {
+                socket_options.defer_accept = *value;
+            } else if (arg == "--fastopen") {
+                socket_options.fast_open_queue = *value;
+            } else if (arg == "--coalesce") {
+                connection_options.coalesce_threshold = *value;
+            } else if (arg == "--max-header-size") {
+                connection_options.max_header_size = *value;
+            } else if (arg == "--drain-timeout") {
+                lifecycle_options.drain_timeout = std::chrono::seconds{*value};
+            } else {
+                warm_up.enabled = true;
+                warm_up.preload_budget = *value;
+            }
+        } else if (arg == "--handoff" && i + 1 < argc) {
+            lifecycle_options.handoff_path = argv[++i];
+        } else if (arg == "--warm-up") {
+            warm_up.enabled = true;
+        } else if (arg == "--no-nodelay") {
+            socket_options.no_delay = false;
+        } else if (arg == "--balance" && i + 1 < argc) {
+            const std::string_view value = argv[++i];
+            if (value == "round-robin") {
+                balancing = http::ProxyRoute::Balancing::RoundRobin;
+            } else if (value == "least-connections") {
+                balancing = http::ProxyRoute::Balancing::LeastConnections;
+            } else {
+                std::println("{}", usage_v);
+                return 1;
+            }
+        } else if (arg == "--proxy" && i + 1 < argc) {
+            auto route = parse_proxy_route(argv[++i], balancing);
+            if (!route) {
+                std::println("{}", usage_v);
+                return 1;
+            }
+            proxy_routes.push_back(std::move(*route));
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() != 4 && args.size() != 6) {
+        std::println("{}", usage_v);
         return 1;
     }
 
-    const auto address = argv[1];
-    const auto port = argv[2];
-    const auto doc_root = argv[3];
-    auto thread_pool_size = std::atoi(argv[4]);
+    const auto address = std::string{args[0]};
+    const auto port = std::string{args[1]};
+    const auto doc_root = std::string{args[2]};
+    auto thread_pool_size = std::atoi(args[3].data());
     if (thread_pool_size <= 0) {
         thread_pool_size = 1; // at least 1 thread so the context can run :3
     }
 
+    auto tls = std::optional<http::TlsConfig>{};
+    if (args.size() == 6) {
+        tls = http::TlsConfig{
+            .certificate_chain = std::string{args[4]},
+            .private_key = std::string{args[5]},
+        };
+    }
+
     auto logger = cx::Logger{std::cout};
 
     using namespace http;
 
     try {
-        Server server{address, port, doc_root,
-                      static_cast<size_t>(thread_pool_size)};
+        Server server{address,
+                      port,
+                      doc_root,
+                      static_cast<size_t>(thread_pool_size),
+                      tls,
+                      std::move(proxy_routes),
+                      socket_options,
+                      connection_options,
+                      std::move(lifecycle_options),
+                      warm_up};
         server.listen_and_serve();
     } catch (const std::exception& e) {
         logger.error("{}", e.what());
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,38 @@
+#include "mime_type.hpp"
+
+#include <array>
+
+namespace http {
+
+std::string_view to_mime_type(std::string_view path) {
+    struct ExtensionMimeType {
+        std::string_view extension;
+        std::string_view mime_type;
+    };
+
+    constexpr static auto map = std::array{
+        ExtensionMimeType{"gif", "image/gif"},
+        ExtensionMimeType{"htm", "text/html"},
+        ExtensionMimeType{"html", "text/html"},
+        ExtensionMimeType{"jpg", "image/jpeg"},
+        ExtensionMimeType{"jpeg", "image/jpeg"},
+        ExtensionMimeType{"png", "image/png"},
+    };
+
+    auto last_dot = path.find_last_of('.');
+    auto last_slash = path.find_last_of('/');
+    auto extension = (last_slash != path.npos) && (last_dot != path.npos) &&
+                             (last_dot > last_slash)
+                         ? path.substr(1 + last_dot)
+                         : std::string_view{};
+
+    for (const auto& pair : map) {
+        if (pair.extension == extension) {
+            return pair.mime_type;
+        }
+    }
+
+    return "text/plain";
+}
+
+} // namespace http
@@ -0,0 +1,46 @@
+#include "negative_cache.hpp"
+
+#include <mutex>
+
+namespace http {
+
+NegativeCache::NegativeCache(std::size_t capacity, clock::duration ttl)
+    : capacity{capacity}, ttl{ttl} {}
+
+bool NegativeCache::contains(std::string_view path) const {
+    std::shared_lock lock{mutex};
+    auto it = expiry.find(path);
+    return it != expiry.end() && clock::now() < it->second;
+}
+
+void NegativeCache::insert(std::string_view path) {
+    if (capacity == 0) {
+        return;
+    }
+
+    const auto expires_at = clock::now() + ttl;
+
+    std::unique_lock lock{mutex};
+    // an expired entry that is seen missing again just gets a new deadline,
+    // so keys in expiry and insertion_order always stay in sync
+    if (auto it = expiry.find(path); it != expiry.end()) {
+        it->second = expires_at;
+        return;
+    }
+
+    if (expiry.size() >= capacity) {
+        expiry.erase(insertion_order.front());
+        insertion_order.pop_front();
+    }
+
+    insertion_order.emplace_back(path);
+    expiry.emplace(insertion_order.back(), expires_at);
+}
+
+void NegativeCache::clear() {
+    std::unique_lock lock{mutex};
+    expiry.clear();
+    insertion_order.clear();
+}
+
+} // namespace http
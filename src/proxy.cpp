@@ -0,0 +1,793 @@
+#include "proxy.hpp"
+#include "request.hpp"
+#include "request_handler.hpp"
+#include "response.hpp"
+
+#include <algorithm>
+#include <array>
+#include <asio/bind_executor.hpp>
+#include <asio/connect.hpp>
+#include <asio/post.hpp>
+#include <asio/strand.hpp>
+#include <asio/write.hpp>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <format>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace http {
+
+namespace {
+
+using tcp = asio::ip::tcp;
+
+constexpr auto connect_timeout_v = std::chrono::seconds{2};
+// longest an upstream may take to accept the request, and to stay silent
+// while a response is read from it
+constexpr auto read_timeout_v = std::chrono::seconds{30};
+constexpr auto health_check_interval_v = std::chrono::seconds{5};
+
+// consecutive failures after which an upstream is ejected from balancing
+constexpr int max_failures_v = 3;
+
+// Idle connections of an upstream are split into shards, and each thread only
+// uses the shard its id hashes to, so threads rarely contend for a lock
+constexpr std::size_t idle_shards_v = 16;
+constexpr std::size_t max_idle_connections_v = 16; // per shard
+constexpr std::size_t max_response_head_size_v = 64 * 1024;
+constexpr std::size_t read_chunk_size_v = 16 * 1024;
+
+// meaningful for a single connection only, so never forwarded
+constexpr auto hop_by_hop_fields_v = std::array<std::string_view, 9>{
+    "Connection",          "Keep-Alive", "Proxy-Connection",
+    "Proxy-Authenticate",  "Proxy-Authorization",
+    "TE",                  "Trailer",    "Transfer-Encoding",
+    "Upgrade",
+};
+
+// The parser stops at the end of the head and never reads a body, so a
+// request that announces one can't be forwarded: the upstream would wait for
+// bytes that never arrive, or read the next request on the connection as them
+bool has_body(const Request& req) {
+    if (req.headers.contains(KnownHeader::TransferEncoding)) {
+        return true;
+    }
+    const auto length = req.headers.get(KnownHeader::ContentLength);
+    return length && *length != "0";
+}
+
+bool icontains(std::string_view str, std::string_view token) {
+    return !std::ranges::search(str, token, [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) ==
+                       std::tolower(static_cast<unsigned char>(b));
+            }).empty();
+}
+
+bool is_hop_by_hop(std::string_view name) {
+    return std::ranges::any_of(hop_by_hop_fields_v, [name](auto field) {
+        return iequals(name, field);
+    });
+}
+
+std::string_view trim(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t')) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+// Decodes a body sent with the chunked transfer coding, which HTTP/1.0
+// clients don't understand
+class ChunkedDecoder {
+  public:
+    // Decode input, appending chunk data to out.
+    // Returns false if the input isn't valid chunked coding
+    bool decode(std::string_view input, std::string& out) {
+        for (auto i = 0uz; i < input.size() && state != State::Done; ++i) {
+            const char c = input[i];
+            switch (state) {
+            case State::Size: {
+                int digit = -1;
+                if (c >= '0' && c <= '9') {
+                    digit = c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    digit = 10 + c - 'a';
+                } else if (c >= 'A' && c <= 'F') {
+                    digit = 10 + c - 'A';
+                }
+
+                if (digit >= 0 && remaining < (1uz << 40)) {
+                    remaining = remaining * 16 + digit;
+                    has_size = true;
+                } else if (has_size && c == ';') {
+                    state = State::Extension;
+                } else if (has_size && c == '\r') {
+                    state = State::SizeEnd;
+                } else {
+                    return false;
+                }
+                break;
+            }
+            case State::Extension:
+                if (c == '\r') {
+                    state = State::SizeEnd;
+                }
+                break;
+            case State::SizeEnd:
+                if (c != '\n') {
+                    return false;
+                }
+                state = remaining == 0 ? State::TrailerStart : State::Data;
+                break;
+            case State::Data: {
+                const auto n = std::min(remaining, input.size() - i);
+                out.append(input.substr(i, n));
+                remaining -= n;
+                i += n - 1;
+                if (remaining == 0) {
+                    state = State::DataCr;
+                }
+                break;
+            }
+            case State::DataCr:
+                if (c != '\r') {
+                    return false;
+                }
+                state = State::DataLf;
+                break;
+            case State::DataLf:
+                if (c != '\n') {
+                    return false;
+                }
+                state = State::Size;
+                has_size = false;
+                break;
+            case State::TrailerStart:
+                state = c == '\r' ? State::End : State::Trailer;
+                break;
+            case State::Trailer: // trailer fields are dropped
+                if (c == '\n') {
+                    state = State::TrailerStart;
+                }
+                break;
+            case State::End:
+                if (c != '\n') {
+                    return false;
+                }
+                state = State::Done;
+                break;
+            case State::Done:
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool done() const { return state == State::Done; }
+
+  private:
+    enum class State {
+        Size,
+        Extension,
+        SizeEnd,
+        Data,
+        DataCr,
+        DataLf,
+        TrailerStart,
+        Trailer,
+        End,
+        Done,
+    } state = State::Size;
+
+    std::size_t remaining = 0;
+    bool has_size = false;
+};
+
+} // namespace
+
+struct ProxyHandler::UpstreamState {
+    Upstream address;
+    tcp::resolver::results_type endpoints;
+
+    std::atomic<int> active = 0; // exchanges currently using the upstream
+    std::atomic<int> failures = 0;
+    std::atomic<bool> ejected = false;
+    std::atomic<bool> checking = false; // a health check is connecting
+
+    struct IdleShard {
+        std::mutex mutex;
+        std::vector<tcp::socket> connections;
+    };
+    std::array<IdleShard, idle_shards_v> idle;
+
+    IdleShard& idle_shard() {
+        static thread_local const auto shard =
+            std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+            idle_shards_v;
+        return idle[shard];
+    }
+
+    std::optional<tcp::socket> take_idle() {
+        auto& shard = idle_shard();
+        std::lock_guard lock{shard.mutex};
+        if (shard.connections.empty()) {
+            return {};
+        }
+        auto socket = std::move(shard.connections.back());
+        shard.connections.pop_back();
+        return socket;
+    }
+
+    void put_idle(tcp::socket socket) {
+        auto& shard = idle_shard();
+        std::lock_guard lock{shard.mutex};
+        if (shard.connections.size() < max_idle_connections_v) {
+            shard.connections.push_back(std::move(socket));
+        }
+    }
+
+    void succeeded() { failures = 0; }
+    void failed() {
+        if (++failures >= max_failures_v) {
+            ejected = true;
+        }
+    }
+};
+
+struct ProxyHandler::Route {
+    std::string prefix;
+    ProxyRoute::Balancing balancing;
+    // shared with the exchanges using them, which can outlive the handler
+    // when the context is destroyed with exchanges still in flight
+    std::vector<std::shared_ptr<UpstreamState>> upstreams;
+    std::atomic<std::size_t> next = 0; // round robin cursor
+};
+
+// A single request forwarded upstream, alive until its response was relayed
+class ProxyHandler::Exchange : public std::enable_shared_from_this<Exchange> {
+  public:
+    Exchange(std::shared_ptr<UpstreamState> upstream, std::string request_head,
+             bool head_request, asio::any_io_executor executor,
+             ProxySink sink)
+        : upstream{std::move(upstream)}, request_head{std::move(request_head)},
+          head_request{head_request}, executor{executor},
+          sink{std::move(sink)}, socket{executor}, timer{executor} {
+        if (this->upstream) {
+            ++this->upstream->active;
+        }
+    }
+
+    ~Exchange() {
+        if (upstream) {
+            --upstream->active;
+        }
+    }
+
+    void start() {
+        if (!upstream) { // every upstream of the route is ejected
+            fail(Response::StatusCode::ServiceUnavailable);
+            return;
+        }
+
+        auto idle = upstream->take_idle();
+        if (!idle) {
+            connect();
+            return;
+        }
+
+        socket = std::move(*idle);
+        reused = true;
+        send_request();
+    }
+
+    // answer without involving an upstream
+    void reject(Response::StatusCode code) { fail(code); }
+
+  private:
+    enum class Framing {
+        Length,
+        Chunked,
+        UntilClose,
+    };
+
+    template <typename Handler> auto bind(Handler&& handler) {
+        return asio::bind_executor(executor, std::forward<Handler>(handler));
+    }
+
+    // close the socket unless the operation that is started next completes
+    // within timeout, which makes it fail
+    void arm_timer(std::chrono::steady_clock::duration timeout) {
+        auto self{shared_from_this()};
+        timer.expires_after(timeout);
+        timer.async_wait(bind([this, self](asio::error_code err) {
+            // a timer that expired just before it was re-armed still runs
+            if (!err && timer.expiry() <= std::chrono::steady_clock::now()) {
+                timed_out = true;
+                socket.close(err);
+            }
+        }));
+    }
+
+    void connect() {
+        auto self{shared_from_this()};
+        reused = false;
+        socket = tcp::socket{executor};
+
+        arm_timer(connect_timeout_v);
+        asio::async_connect(
+            socket, upstream->endpoints,
+            bind([this, self](asio::error_code err, const tcp::endpoint&) {
+                timer.cancel();
+                if (err) {
+                    upstream->failed();
+                    fail(Response::StatusCode::BadGateway);
+                    return;
+                }
+                send_request();
+            }));
+    }
+
+    // A pooled connection may have been closed by the upstream while idle,
+    // that's retried once on a fresh connection and not held against it
+    void retry_or_fail() {
+        if (timed_out) {
+            upstream->failed();
+            fail(Response::StatusCode::GatewayTimeout);
+            return;
+        }
+        if (reused && buffered == 0 && !interim) {
+            connect();
+            return;
+        }
+        upstream->failed();
+        fail(Response::StatusCode::BadGateway);
+    }
+
+    void send_request() {
+        auto self{shared_from_this()};
+        // an upstream that stops reading is given up on like a silent one
+        arm_timer(read_timeout_v);
+        asio::async_write(
+            socket, asio::buffer(request_head),
+            bind([this, self](asio::error_code err, std::size_t) {
+                timer.cancel();
+                if (err) {
+                    retry_or_fail();
+                    return;
+                }
+                read_head();
+            }));
+    }
+
+    void read_head() {
+        auto self{shared_from_this()};
+        buffer.resize(std::max(buffer.size(), buffered + read_chunk_size_v));
+        arm_timer(read_timeout_v);
+        socket.async_read_some(
+            asio::buffer(buffer.data() + buffered, buffer.size() - buffered),
+            bind([this, self](asio::error_code err, std::size_t bytes_read) {
+                timer.cancel();
+                if (err) {
+                    retry_or_fail();
+                    return;
+                }
+
+                buffered += bytes_read;
+                find_head();
+            }));
+    }
+
+    // handle the response head if it was read completely, or read more
+    void find_head() {
+        const auto end =
+            std::string_view{buffer.data(), buffered}.find("\r\n\r\n");
+        if (end != std::string_view::npos) {
+            on_head(end + 4);
+        } else if (buffered < max_response_head_size_v) {
+            read_head();
+        } else {
+            upstream->failed();
+            fail(Response::StatusCode::BadGateway);
+        }
+    }
+
+    void on_head(std::size_t head_size) {
+        auto lines = std::string_view{buffer.data(), head_size - 2};
+
+        // HTTP/1.x 200 Ok
+        auto line_end = lines.find("\r\n");
+        const auto status_line = lines.substr(0, line_end);
+        lines.remove_prefix(line_end + 2);
+
+        int status = 0;
+        const auto code = status_line.substr(std::min(status_line.size(), 9uz));
+        auto [ptr, ec] =
+            std::from_chars(code.data(), code.data() + code.size(), status);
+        if (!status_line.starts_with("HTTP/1.") || status_line.size() < 12 ||
+            ec != std::errc{} || ptr != code.data() + 3 || status < 100) {
+            upstream->failed();
+            fail(Response::StatusCode::BadGateway);
+            return;
+        }
+
+        // interim responses (100 Continue, 103 Early Hints) mean nothing to
+        // an HTTP/1.0 client, so they're dropped and the final response is
+        // read after them. Nothing was asked to be upgraded, so 101 is bogus
+        if (status < 200) {
+            if (status == 101) {
+                upstream->failed();
+                fail(Response::StatusCode::BadGateway);
+                return;
+            }
+            buffer.erase(0, head_size);
+            buffered -= head_size;
+            interim = true;
+            find_head();
+            return;
+        }
+        keep_alive = status_line.starts_with("HTTP/1.1");
+
+        // the client is spoken to in HTTP/1.0, so the body is always
+        // delimited for it by closing the connection
+        head = std::format("HTTP/1.0 {}\r\n", status_line.substr(9));
+        auto chunked_coding = false;
+        auto content_length = std::optional<std::size_t>{};
+        for (; !lines.empty(); lines.remove_prefix(line_end + 2)) {
+            line_end = lines.find("\r\n");
+            const auto line = lines.substr(0, line_end);
+            const auto colon = line.find(':');
+            if (colon == std::string_view::npos) {
+                continue;
+            }
+
+            const auto name = line.substr(0, colon);
+            const auto value = trim(line.substr(colon + 1));
+            if (iequals(name, "Connection")) {
+                keep_alive = keep_alive ? !icontains(value, "close")
+                                        : icontains(value, "keep-alive");
+            } else if (iequals(name, "Transfer-Encoding")) {
+                chunked_coding = icontains(value, "chunked");
+            } else if (iequals(name, "Content-Length")) {
+                std::size_t length = 0;
+                const auto end = value.data() + value.size();
+                auto [ptr, ec] = std::from_chars(value.data(), end, length);
+                if (ec != std::errc{} || ptr != end) { // body can't be framed
+                    upstream->failed();
+                    fail(Response::StatusCode::BadGateway);
+                    return;
+                }
+                content_length = length;
+            }
+
+            if (!is_hop_by_hop(name)) {
+                std::format_to(std::back_inserter(head), "{}: {}\r\n", name,
+                               value);
+            }
+        }
+        head += "\r\n";
+
+        // a response to HEAD announces the body a GET would get, without it
+        if (head_request || status == 204 || status == 304) {
+            framing = Framing::Length;
+            remaining = 0;
+        } else if (chunked_coding) {
+            framing = Framing::Chunked;
+        } else if (content_length) {
+            framing = Framing::Length;
+            remaining = *content_length;
+        } else {
+            framing = Framing::UntilClose;
+            keep_alive = false;
+        }
+
+        upstream->succeeded();
+        responded = true;
+
+        auto self{shared_from_this()};
+        sink.write(head, [this, self, head_size](bool ok) {
+            if (!ok) {
+                keep_alive = false;
+                complete();
+                return;
+            }
+            relay({buffer.data() + head_size, buffered - head_size});
+        });
+    }
+
+    // forward a piece of the body to the client, then keep reading
+    void relay(std::string_view data) {
+        std::string_view out = data;
+        switch (framing) {
+        case Framing::Length:
+            out = data.substr(0, remaining);
+            remaining -= out.size();
+            keep_alive = keep_alive && out.size() == data.size();
+            break;
+        case Framing::Chunked:
+            decoded.clear();
+            if (!chunked.decode(data, decoded)) {
+                keep_alive = false;
+                complete();
+                return;
+            }
+            out = decoded;
+            break;
+        case Framing::UntilClose:
+            break;
+        }
+
+        if (out.empty()) {
+            read_body();
+            return;
+        }
+
+        auto self{shared_from_this()};
+        sink.write(out, [this, self](bool ok) {
+            if (!ok) {
+                keep_alive = false;
+                complete();
+                return;
+            }
+            read_body();
+        });
+    }
+
+    void read_body() {
+        if ((framing == Framing::Length && remaining == 0) ||
+            (framing == Framing::Chunked && chunked.done())) {
+            complete();
+            return;
+        }
+
+        auto self{shared_from_this()};
+        buffer.resize(std::max(buffer.size(), read_chunk_size_v));
+        arm_timer(read_timeout_v);
+        socket.async_read_some(
+            asio::buffer(buffer),
+            bind([this, self](asio::error_code err, std::size_t bytes_read) {
+                timer.cancel();
+                if (err) { // only a clean end for bodies delimited by close
+                    keep_alive = false;
+                    complete();
+                    return;
+                }
+                relay({buffer.data(), bytes_read});
+            }));
+    }
+
+    void complete() {
+        if (keep_alive && socket.is_open()) {
+            upstream->put_idle(std::move(socket));
+        }
+        sink.finish();
+    }
+
+    // answer with a stock response, unless part of a response was already
+    // written
+    void fail(Response::StatusCode code) {
+        if (responded) {
+            sink.finish();
+            return;
+        }
+
+        responded = true;
+        auto self{shared_from_this()};
+        sink.write(Response::from(code).serialized,
+                   [this, self](bool) { sink.finish(); });
+    }
+
+    std::shared_ptr<UpstreamState> upstream;
+    std::string request_head;
+    bool head_request; // the response has no body, whatever its head says
+    asio::any_io_executor executor;
+    ProxySink sink;
+
+    tcp::socket socket;
+    asio::steady_timer timer; // bounds connecting, writing and each read
+    bool timed_out = false;
+    bool reused = false;
+    bool responded = false; // the client got (part of) a response
+
+    std::string buffer;
+    std::size_t buffered = 0; // bytes of the response head in buffer
+    bool interim = false;     // a 1xx head was read, and skipped
+    std::string head;         // response head written to the client
+
+    Framing framing = Framing::UntilClose;
+    std::size_t remaining = 0;
+    ChunkedDecoder chunked;
+    std::string decoded;
+    bool keep_alive = false;
+};
+
+ProxyHandler::ProxyHandler(asio::io_context& context,
+                           std::vector<ProxyRoute> proxy_routes)
+    : context{context}, health_check_timer{asio::make_strand(context)} {
+    auto resolver = tcp::resolver{context};
+    for (auto& proxy_route : proxy_routes) {
+        auto route = std::make_unique<Route>();
+        route->prefix = std::move(proxy_route.prefix);
+        route->balancing = proxy_route.balancing;
+        for (auto& address : proxy_route.upstreams) {
+            auto upstream = std::make_shared<UpstreamState>();
+            upstream->endpoints = resolver.resolve(address.host, address.port);
+            upstream->address = std::move(address);
+            route->upstreams.push_back(std::move(upstream));
+        }
+        routes.push_back(std::move(route));
+    }
+
+    if (!routes.empty()) {
+        schedule_health_check();
+    }
+}
+
+ProxyHandler::~ProxyHandler() = default;
+
+bool ProxyHandler::matches(const Request& req, std::string& path) const {
+    if (routes.empty()) { // nothing is proxied, no need to decode anything
+        return false;
+    }
+    // malformed paths and paths with ".." segments are left to the request
+    // handler, which refuses them
+    return decode_url(req.uri, path) && find_route(path) != nullptr;
+}
+
+void ProxyHandler::forward(const Request& req, std::string_view path,
+                           std::string client_address,
+                           asio::any_io_executor executor, ProxySink sink) {
+    if (has_body(req)) {
+        std::make_shared<Exchange>(nullptr, std::string{}, false, executor,
+                                   std::move(sink))
+            ->reject(Response::StatusCode::NotImplemented);
+        return;
+    }
+
+    // the path is forwarded the way it was matched, so upstreams can't be
+    // asked for anything outside the prefix of the route
+    auto* route = find_route(path);
+    auto target = encode_url(path);
+    if (const auto query = req.uri.find('?'); query != std::string::npos) {
+        target.append(req.uri, query);
+    }
+
+    // upstreams are spoken to in HTTP/1.1, so connections can be reused.
+    // Requests are forwarded without a body, so they don't announce one
+    auto head = std::format("{} {} HTTP/1.1\r\n", req.method, target);
+    req.headers.for_each(
+        [&head](std::string_view name, std::string_view value) {
+            if (!is_hop_by_hop(name) && !iequals(name, "Content-Length")) {
+                std::format_to(std::back_inserter(head), "{}: {}\r\n", name,
+                               value);
+            }
+        });
+
+    auto upstream = route ? select_upstream(*route) : nullptr;
+    if (!req.headers.contains(KnownHeader::Host) && upstream) {
+        std::format_to(std::back_inserter(head), "Host: {}:{}\r\n",
+                       upstream->address.host, upstream->address.port);
+    }
+    std::format_to(std::back_inserter(head),
+                   "X-Forwarded-For: {}\r\n"
+                   "Connection: keep-alive\r\n"
+                   "\r\n",
+                   client_address);
+
+    std::make_shared<Exchange>(std::move(upstream), std::move(head),
+                               req.method == "HEAD", executor, std::move(sink))
+        ->start();
+}
+
+auto ProxyHandler::find_route(std::string_view path) const -> Route* {
+    // the longest matching prefix wins, and it has to end at a path boundary
+    Route* match = nullptr;
+    for (const auto& route : routes) {
+        const auto& prefix = route->prefix;
+        if (!path.starts_with(prefix)) {
+            continue;
+        }
+        const auto boundary = prefix.ends_with('/') ||
+                              path.size() == prefix.size() ||
+                              path[prefix.size()] == '/';
+        if (boundary && (!match || prefix.size() > match->prefix.size())) {
+            match = route.get();
+        }
+    }
+    return match;
+}
+
+auto ProxyHandler::select_upstream(Route& route)
+    -> std::shared_ptr<UpstreamState> {
+    const auto& upstreams = route.upstreams;
+    const auto start = route.next.fetch_add(1, std::memory_order_relaxed);
+
+    std::shared_ptr<UpstreamState> selected;
+    for (auto i = 0uz; i < upstreams.size(); ++i) {
+        const auto& upstream = upstreams[(start + i) % upstreams.size()];
+        if (upstream->ejected) {
+            continue;
+        }
+        if (route.balancing == ProxyRoute::Balancing::RoundRobin) {
+            return upstream;
+        }
+        if (!selected || upstream->active < selected->active) {
+            selected = upstream;
+        }
+    }
+    return selected;
+}
+
+void ProxyHandler::stop() {
+    asio::post(health_check_timer.get_executor(), [this]() {
+        stopped = true;
+        health_check_timer.cancel();
+    });
+
+    for (const auto& route : routes) {
+        for (const auto& upstream : route->upstreams) {
+            for (auto& shard : upstream->idle) {
+                std::lock_guard lock{shard.mutex};
+                shard.connections.clear();
+            }
+        }
+    }
+}
+
+void ProxyHandler::schedule_health_check() {
+    if (stopped) {
+        return;
+    }
+    health_check_timer.expires_after(health_check_interval_v);
+    health_check_timer.async_wait([this](asio::error_code err) {
+        if (!err) {
+            do_health_check();
+            schedule_health_check();
+        }
+    });
+}
+
+void ProxyHandler::do_health_check() {
+    // an ejected upstream is put back into balancing once it accepts
+    // connections again. A check is bounded like any other connect, and
+    // none is started while the last one is still pending, so checks don't
+    // pile up on an upstream that drops connection attempts
+    for (const auto& route : routes) {
+        for (const auto& upstream : route->upstreams) {
+            if (!upstream->ejected || upstream->checking.exchange(true)) {
+                continue;
+            }
+
+            // on a strand, so the timer can't close the socket while the
+            // connect completes
+            auto strand = asio::make_strand(context);
+            auto socket = std::make_shared<tcp::socket>(strand);
+            auto timer = std::make_shared<asio::steady_timer>(strand);
+            timer->expires_after(connect_timeout_v);
+            timer->async_wait([socket](asio::error_code err) {
+                if (!err) {
+                    socket->close(err);
+                }
+            });
+            asio::async_connect(
+                *socket, upstream->endpoints,
+                [socket, timer, upstream](asio::error_code err,
+                                          const tcp::endpoint&) {
+                    timer->cancel();
+                    if (!err) {
+                        upstream->failures = 0;
+                        upstream->ejected = false;
+                    }
+                    upstream->checking = false;
+                });
+        }
+    }
+}
+
+} // namespace http
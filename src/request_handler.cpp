@@ -1,39 +1,22 @@
 #include "request_handler.hpp"
+#include "mime_type.hpp"
 #include "request.hpp"
 #include "response.hpp"
 
-#include <array>
-#include <filesystem>
-#include <fstream>
-#include <optional>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/openat2.h>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
 
 namespace {
 
-std::string to_mime_type(const std::string& extension) {
-    struct ExtensionMimeType {
-        std::string extension;
-        std::string mime_type;
-    };
-
-    constexpr static auto map = std::array{
-        ExtensionMimeType{"gif", "image/gif"},
-        ExtensionMimeType{"htm", "text/html"},
-        ExtensionMimeType{"html", "text/html"},
-        ExtensionMimeType{"jpg", "image/jpeg"},
-        ExtensionMimeType{"jpeg", "image/jpeg"},
-        ExtensionMimeType{"png", "image/png"},
-    };
-
-    for (const auto& pair : map) {
-        if (pair.extension == extension) {
-            return pair.mime_type;
-        }
-    }
-
-    return "text/plain";
-}
-
 int to_hex(char c) {
     if (c >= '0' && c <= '9') {
         return c - '0';
@@ -50,81 +33,277 @@ int to_hex(char c) {
     return -1;
 }
 
+// a 200 response for content of the given size, the caller sets the content
+http::Response ok(std::size_t size, std::string_view mime_type,
+                  std::string etag) {
+    using http::Response;
+    Response response;
+    response.status = Response::StatusCode::Ok;
+    response.headers.push_back({"Content-Length", std::to_string(size)});
+    response.headers.push_back({"Content-Type", std::string{mime_type}});
+    response.headers.push_back({"ETag", std::move(etag)});
+    response.date = http::http_date();
+    return response;
+}
+
+http::Response redirect(const std::string& location) {
+    using http::Response;
+    Response response;
+    response.status = Response::StatusCode::MovedPermanently;
+    response.headers.push_back({"Location", location});
+    response.headers.push_back({"Content-Length", "0"});
+    response.date = http::http_date();
+    return response;
+}
+
 } // namespace
 
 namespace http {
 
-std::optional<std::string> decode_url(const std::string& str) {
-    std::string ret;
-    for (auto i = 0uz; i < str.size(); ++i) {
-        if (str[i] == '%') { // replace %xx with
+bool decode_url(std::string_view uri, std::string& out) {
+    out.clear();
+    if (!uri.starts_with('/')) {
+        return false;
+    }
+
+    // start of the segment currently being decoded, i.e one past its '/'
+    auto segment = 1uz;
+    out.push_back('/');
+
+    // a segment ends at a '/' or at the end of the path; "." segments are
+    // dropped, ".." segments are rejected and empty ones are collapsed
+    auto end_segment = [&out, &segment]() {
+        const auto name = std::string_view{out}.substr(segment);
+        if (name == "..") {
+            return false;
+        }
+        if (name == ".") {
+            out.resize(segment);
+        }
+        return true;
+    };
+
+    for (auto i = 1uz; i < uri.size() && uri[i] != '?'; ++i) {
+        char c = uri[i];
+        if (c == '%') { // replace %xx with the byte it encodes
             // missing one or both hex values after %
-            if ((i + 2) >= str.size()) {
-                return {};
+            if ((i + 2) >= uri.size()) {
+                return false;
             }
 
-            int hi = to_hex(str[i + 1]);
-            int lo = to_hex(str[i + 2]);
-            if (!hi || !lo) {
-                return {};
+            int hi = to_hex(uri[i + 1]);
+            int lo = to_hex(uri[i + 2]);
+            if (hi < 0 || lo < 0) {
+                return false;
             }
 
             i += 2;
-            ret += static_cast<char>((hi << 4) | lo);
-        } else if (str[i] == '+') { // replace + with ' '
-            ret += ' ';
-        } else {
-            ret += str[i];
+            c = static_cast<char>((hi << 4) | lo);
+        } else if (c == '+') { // replace + with ' '
+            c = ' ';
+        }
+
+        // can't be passed on to the filesystem, whether escaped or not (the
+        // HTTP/1 parser rejects it, an HTTP/2 :path may carry it)
+        if (c == '\0') {
+            return false;
+        }
+
+        if (c != '/') {
+            out.push_back(c);
+            continue;
+        }
+
+        if (!end_segment()) {
+            return false;
+        }
+        if (out.size() > segment) {
+            out.push_back('/');
+            segment = out.size();
         }
     }
 
-    return ret;
+    return end_segment();
 }
 
-RequestHandler::RequestHandler(const std::string& root) : root{root} {}
+std::string encode_url(std::string_view path) {
+    // sub-delims that mean nothing to decode_url are left alone, '+' isn't
+    // one of them as it decodes to ' '
+    constexpr std::string_view allowed = "-._~!$&'()*,;=:@/";
+    constexpr std::string_view hex = "0123456789ABCDEF";
+
+    std::string out;
+    out.reserve(path.size());
+    for (const char c : path) {
+        const auto byte = static_cast<unsigned char>(c);
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || allowed.contains(c)) {
+            out.push_back(c);
+            continue;
+        }
+        out.push_back('%');
+        out.push_back(hex[byte >> 4]);
+        out.push_back(hex[byte & 0xf]);
+    }
+    return out;
+}
+
+RequestHandler::RequestHandler(const std::string& root,
+                               WarmUpOptions warm_up)
+    : root_path{root},
+      root{::open(root.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)},
+      missing{missing_cache_capacity, missing_cache_ttl}, warm_up{warm_up} {
+    if (!this->root) {
+        throw std::system_error{errno, std::system_category(),
+                                "cannot open document root " + root};
+    }
+    if (warm_up.enabled) {
+        index.store(DocumentIndex::build(this->root.get(), warm_up));
+    }
+}
+
+bool RequestHandler::reload() {
+    auto reloaded = prepare_reload();
+    if (!reloaded) {
+        return false;
+    }
+    apply_reload(std::move(*reloaded));
+    return true;
+}
+
+auto RequestHandler::prepare_reload() const -> std::optional<Reloaded> {
+    auto reopened = FileDescriptor{
+        ::open(root_path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)};
+    if (!reopened) {
+        return std::nullopt;
+    }
+
+    auto rebuilt = warm_up.enabled
+                       ? DocumentIndex::build(reopened.get(), warm_up)
+                       : nullptr;
+    return Reloaded{std::move(reopened), std::move(rebuilt)};
+}
+
+void RequestHandler::apply_reload(Reloaded reloaded) {
+    {
+        std::unique_lock lock{root_mutex};
+        root = std::move(reloaded.root);
+    }
+    index.store(std::move(reloaded.index));
+    missing.clear();
+}
+
+FileDescriptor RequestHandler::open_beneath_root(const std::string& path) const {
+    // skip the leading '/' so the path is relative to the document root
+    const auto relative = path.c_str() + 1;
+
+    // whatever the path turns out to be is only looked at after it's open,
+    // and opening a fifo would block until a writer shows up
+    constexpr auto flags = O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC;
+
+    // openat2 lets the kernel refuse any resolution that would leave the
+    // document root, including through symlinks. On kernels without it, ".."
+    // segments are still rejected while decoding but symlinks are followed
+    static std::atomic<bool> has_openat2 = true;
+    if (has_openat2.load(std::memory_order_relaxed)) {
+        open_how how{};
+        how.flags = flags;
+        how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+        auto fd = static_cast<int>(
+            ::syscall(SYS_openat2, root.get(), relative, &how, sizeof(how)));
+        if (fd >= 0 || errno != ENOSYS) {
+            return FileDescriptor{fd};
+        }
+        has_openat2.store(false, std::memory_order_relaxed);
+    }
+
+    return FileDescriptor{::openat(root.get(), relative, flags)};
+}
 
 Response RequestHandler::handle(const Request& req) {
-    auto decoded = decode_url(req.uri);
+    // reused across requests, so decoding doesn't allocate once warmed up
+    thread_local std::string path;
 
-    // require decodable, not empty, absolute path and not containing ".."
-    if (!decoded || decoded->empty() || !decoded->starts_with('/') ||
-        decoded->contains("..")) {
+    // require decodable, absolute path without ".." segments
+    if (!decode_url(req.uri, path)) {
         return Response::from(Response::StatusCode::BadRequest);
     }
 
-    if (decoded->ends_with('/')) {
-        decoded->append("index.html");
+    if (path.ends_with('/')) {
+        path.append("index.html");
     }
 
-    namespace fs = std::filesystem;
+    const auto current = index.load();
+    const auto* indexed = current ? current->find(path) : nullptr;
+    if (indexed && indexed->preloaded) { // served from memory
+        auto response =
+            ok(indexed->content.size(), indexed->mime_type, indexed->etag);
+        // shares the index instead of copying the file, so it stays valid
+        // while written even if a reload replaces the index
+        response.shared_content = {current, &indexed->content};
+        return response;
+    }
 
-    const auto path = decoded.value();
-    auto last_dot = path.find_last_of('.');
-    auto last_slash = path.find_last_of('/');
-    auto extension =
-        (last_slash != path.npos) && (last_dot > last_slash)
-            ? path.substr(1 + last_dot)
-            : "";
+    if (missing.contains(path)) {
+        return Response::from(Response::StatusCode::NotFound);
+    }
 
-    const auto full_path = root + path;
-    std::ifstream file{full_path, std::ios::binary};
+    auto file = FileDescriptor{};
+    auto error = 0;
+    {
+        std::shared_lock lock{root_mutex};
+        file = open_beneath_root(path);
+        error = errno;
+    }
     if (!file) {
-        return Response::from(Response::StatusCode::BadRequest);
+        switch (error) {
+        case ENOENT:
+        case ENOTDIR:
+        case ENAMETOOLONG:
+            missing.insert(path);
+            return Response::from(Response::StatusCode::NotFound);
+        case EACCES:
+        case EPERM:
+        case EXDEV: // resolution tried to escape the document root
+        case ELOOP:
+            return Response::from(Response::StatusCode::Forbidden);
+        default:
+            return Response::from(Response::StatusCode::InternalServerError);
+        }
     }
 
-    Response response;
-    response.status = Response::StatusCode::Ok;
-    response.content = std::string(fs::file_size(full_path), '\0');
-    if (!file.read(response.content.data(), response.content.size())) {
+    struct stat info{};
+    if (::fstat(file.get(), &info) != 0) {
+        return Response::from(Response::StatusCode::InternalServerError);
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        // point the client at the directory itself, so relative links in its
+        // index resolve correctly. Built from the normalized path, as the raw
+        // uri could start with "//" and name another host
+        return redirect(encode_url(path) + '/');
+    }
+
+    if (!S_ISREG(info.st_mode)) { // devices, fifos, sockets...
+        return Response::from(Response::StatusCode::Forbidden);
+    }
+
+    auto content = std::string(info.st_size, '\0');
+    if (!read_all(file.get(), content)) {
         return Response::from(Response::StatusCode::InternalServerError);
     }
 
-    response.headers.push_back({
-        "Content-Length",
-        std::to_string(response.content.size()),
-    });
-    response.headers.push_back({"Content-Type", to_mime_type(extension)});
+    // a file that is still the way it was indexed takes its headers from the
+    // index, one that changed since gets them worked out again
+    const auto unchanged =
+        indexed && indexed->size == content.size() &&
+        indexed->modified == info.st_mtime;
+    auto response =
+        unchanged ? ok(content.size(), indexed->mime_type, indexed->etag)
+                  : ok(content.size(), to_mime_type(path),
+                       to_etag(info.st_size, info.st_mtime));
+    response.content = std::move(content);
     return response;
 }
 
-} // namespace http
\ No newline at end of file
+} // namespace http
@@ -17,6 +17,20 @@ bool is_special(char c) {
 
 bool is_alpha(int c) { return c >= 0 && c <= 127; }
 bool is_digit(int c) { return c >= '0' && c <= '9'; }
+
+// versions are a single digit in practice, the bound only keeps a long run of
+// digits from overflowing the version number
+constexpr int max_version_v = 999;
+
+// append a digit to a version number, false if it would exceed max_version_v
+bool push_digit(int& version, char c) {
+    if (version > (max_version_v - (c - '0')) / 10) {
+        return false;
+    }
+    version = version * 10 + c - '0';
+    return true;
+}
+
 bool is_invalid(int c) {
     return !is_alpha(c) || is_control_character(c) || is_special(c);
 }
@@ -26,6 +40,9 @@ bool is_invalid(int c) {
 auto RequestParser::parse(Request& req, std::string_view input) noexcept
     -> Result {
     for (auto it = input.begin(); it != input.end(); ++it) {
+        if (++head_size > max_head_size) {
+            return Result::TooLarge;
+        }
         if (auto err = consume(req, *it); err != Result::Indeterminate) {
             return err;
         }
@@ -109,8 +126,9 @@ auto RequestParser::consume(Request& req, char input) -> Result {
 
     case State::HttpVersionMajor:
         if (is_digit(input)) {
-            req.version.major = req.version.major * 10 + input - '0';
-            return Result::Indeterminate;
+            return push_digit(req.version.major, input)
+                       ? Result::Indeterminate
+                       : Result::Invalid;
         } else if (input == '.') {
             state = State::HttpVersionMinorStart;
             return Result::Indeterminate;
@@ -127,8 +145,9 @@ auto RequestParser::consume(Request& req, char input) -> Result {
 
     case State::HttpVersionMinor:
         if (is_digit(input)) {
-            req.version.minor = req.version.minor * 10 + input - '0';
-            return Result::Indeterminate;
+            return push_digit(req.version.minor, input)
+                       ? Result::Indeterminate
+                       : Result::Invalid;
         } else if (input == '\r') {
             state = State::HttpVersionEnd;
             return Result::Indeterminate;
@@ -153,8 +172,9 @@ auto RequestParser::consume(Request& req, char input) -> Result {
         }
 
         state = State::HeaderName;
-        req.headers.emplace_back();
-        req.headers.back().name.push_back(input);
+        field.name.clear();
+        field.value.clear();
+        field.name.push_back(input);
         return Result::Indeterminate;
 
     case State::HeaderName:
@@ -164,7 +184,7 @@ auto RequestParser::consume(Request& req, char input) -> Result {
         } else if (is_invalid(input)) {
             return Result::Invalid;
         }
-        req.headers.back().name.push_back(input);
+        field.name.push_back(input);
         return Result::Indeterminate;
 
     case State::HeaderNameEnd:
@@ -182,12 +202,13 @@ auto RequestParser::consume(Request& req, char input) -> Result {
         } else if (is_control_character(input)) {
             return Result::Invalid;
         }
-        req.headers.back().value.push_back(input);
+        field.value.push_back(input);
         return Result::Indeterminate;
 
     case State::HeaderValueEnd:
         if (input == '\n') {
             state = State::HeaderLineStart;
+            req.headers.add(field.name, field.value);
             return Result::Indeterminate;
         }
         return Result::Invalid;
@@ -1,7 +1,11 @@
 #include "response.hpp"
 
+#include <algorithm>
+#include <array>
 #include <asio.hpp>
+#include <ctime>
 #include <format>
+#include <iterator>
 #include <string>
 #include <utility>
 
@@ -34,6 +38,8 @@ std::string_view to_string(Response::StatusCode code) {
         return "Forbidden";
     case NotFound:
         return "Not Found";
+    case RequestHeaderFieldsTooLarge:
+        return "Request Header Fields Too Large";
     case InternalServerError:
         return "Internal Server Error";
     case NotImplemented:
@@ -42,59 +48,206 @@ std::string_view to_string(Response::StatusCode code) {
         return "Bad Gateway";
     case ServiceUnavailable:
         return "Service Unavailable";
+    case GatewayTimeout:
+        return "Gateway Timeout";
     default:
         return "Internal Server Error";
         break;
     }
 }
 
-namespace status_line {
-std::string create(Response::StatusCode code) {
+namespace {
+
+constexpr std::string_view date_field_v = "Date";
+constexpr std::string_view header_separator_v = ": ";
+constexpr std::string_view crlf_v = "\r\n";
+
+using enum Response::StatusCode;
+
+constexpr auto status_codes_v = std::array{
+    Ok,
+    Created,
+    Accepted,
+    NoContent,
+    MultipleChoices,
+    MovedPermanently,
+    MovedTemporarily,
+    NotModified,
+    BadRequest,
+    Unauthorized,
+    Forbidden,
+    NotFound,
+    RequestHeaderFieldsTooLarge,
+    InternalServerError,
+    NotImplemented,
+    BadGateway,
+    ServiceUnavailable,
+    GatewayTimeout,
+};
+
+// everything needed to answer with a status code, built once and never
+// modified afterwards so it can be shared across threads without locking
+struct StockEntry {
+    std::string status_line;
+    Response response;
+    std::string serialized;
+};
+
+std::string create_status_line(Response::StatusCode code) {
     return std::format("HTTP/1.0 {} {}\r\n", std::to_underlying(code),
                        to_string(code));
 }
-} // namespace status_line
 
-namespace content {
-std::string create(Response::StatusCode code) {
+std::string create_content(Response::StatusCode code) {
     static constexpr auto fmt = "<html>"
                                 "<head><title>{1}</title></head>"
                                 "<body><h1>{0} {1}</h1></body>"
                                 "</html>";
     return std::format(fmt, std::to_underlying(code), to_string(code));
 }
-} // namespace content
 
-auto Response::to_buffers() -> std::vector<asio::const_buffer> {
-    static constexpr std::string_view header_separator_v = ": ";
-    static constexpr std::string_view crlf_v = "\r\n";
+StockEntry create_stock_entry(Response::StatusCode code) {
+    StockEntry entry{.status_line = create_status_line(code)};
+
+    auto& response = entry.response;
+    response.status = code;
+    response.content = create_content(code);
+    response.headers.push_back(Header{
+        "Content-Length",
+        std::to_string(response.content.size()),
+    });
+    response.headers.push_back(Header{"Content-Type", "text/html"});
+
+    entry.serialized = entry.status_line;
+    for (const auto& header : response.headers) {
+        std::format_to(std::back_inserter(entry.serialized), "{}: {}\r\n",
+                       header.name, header.value);
+    }
+    entry.serialized += "\r\n";
+    entry.serialized += response.content;
+    return entry;
+}
+
+const StockEntry& stock_entry(Response::StatusCode code) {
+    static const auto table = [] {
+        std::array<StockEntry, status_codes_v.size()> table;
+        for (auto i = 0uz; i < status_codes_v.size(); ++i) {
+            table[i] = create_stock_entry(status_codes_v[i]);
+        }
+        return table;
+    }();
 
-    status_line = status_line::create(status);
+    auto it = std::ranges::find(status_codes_v, code);
+    if (it == status_codes_v.end()) {
+        it = std::ranges::find(status_codes_v, InternalServerError);
+    }
+    return table[std::distance(status_codes_v.begin(), it)];
+}
+
+} // namespace
+
+std::string_view to_status_line(Response::StatusCode code) {
+    return stock_entry(code).status_line;
+}
+
+std::shared_ptr<const std::string> http_date() {
+    // IMF-fixdate, e.g "Sun, 06 Nov 1994 08:49:37 GMT"
+    thread_local std::shared_ptr<const std::string> date;
+    thread_local std::time_t last = -1;
+
+    const auto now = std::time(nullptr);
+    if (now != last) {
+        std::array<char, 32> buffer{};
+        std::tm tm{};
+        gmtime_r(&now, &tm);
+        const auto length = std::strftime(buffer.data(), buffer.size(),
+                                          "%a, %d %b %Y %H:%M:%S GMT", &tm);
+        date = std::make_shared<const std::string>(buffer.data(), length);
+        last = now;
+    }
+    return date;
+}
+
+auto Response::to_buffers() const -> std::vector<asio::const_buffer> {
+    if (!serialized.empty()) {
+        return {asio::buffer(serialized)};
+    }
 
     std::vector<asio::const_buffer> buffers;
-    buffers.push_back(asio::buffer(status_line));
+    buffers.reserve(3 + 4 * (headers.size() + 1));
+    buffers.push_back(asio::buffer(to_status_line(status)));
     for (const auto& header : headers) {
         buffers.push_back(asio::buffer(header.name));
         buffers.push_back(asio::buffer(header_separator_v));
         buffers.push_back(asio::buffer(header.value));
         buffers.push_back(asio::buffer(crlf_v));
     }
+    if (date) {
+        buffers.push_back(asio::buffer(date_field_v));
+        buffers.push_back(asio::buffer(header_separator_v));
+        buffers.push_back(asio::buffer(*date));
+        buffers.push_back(asio::buffer(crlf_v));
+    }
     buffers.push_back(asio::buffer(crlf_v));
-    buffers.push_back(asio::buffer(content));
+    buffers.push_back(asio::buffer(body()));
     return buffers;
 }
 
+std::size_t Response::size() const {
+    if (!serialized.empty()) {
+        return serialized.size();
+    }
+
+    auto size = to_status_line(status).size();
+    for (const auto& header : headers) {
+        size += header.name.size() + header_separator_v.size() +
+                header.value.size() + crlf_v.size();
+    }
+    if (date) {
+        size += date_field_v.size() + header_separator_v.size() +
+                date->size() + crlf_v.size();
+    }
+    return size + crlf_v.size() + body().size();
+}
+
+void Response::serialize_to(std::string& out) const {
+    if (!serialized.empty()) {
+        out.append(serialized);
+        return;
+    }
+
+    out.reserve(out.size() + size());
+    out.append(to_status_line(status));
+    for (const auto& header : headers) {
+        out.append(header.name);
+        out.append(header_separator_v);
+        out.append(header.value);
+        out.append(crlf_v);
+    }
+    if (date) {
+        out.append(date_field_v);
+        out.append(header_separator_v);
+        out.append(*date);
+        out.append(crlf_v);
+    }
+    out.append(crlf_v);
+    out.append(body());
+}
+
+std::string_view Response::body() const {
+    return shared_content ? *shared_content : content;
+}
+
 Response Response::from(Response::StatusCode code) {
-    Response ret{
-        .status = code,
-        .content = content::create(code),
+    const auto& entry = stock_entry(code);
+    return Response{
+        .status = entry.response.status,
+        .serialized = entry.serialized,
     };
-    ret.headers.push_back(Header{
-        "Content-Length",
-        std::to_string(ret.content.size()),
-    });
-    ret.headers.push_back(Header{"Content-Type", "text/html"});
-    return ret;
 }
 
-} // namespace http
\ No newline at end of file
+const Response& Response::stock(Response::StatusCode code) {
+    return stock_entry(code).response;
+}
+
+} // namespace http
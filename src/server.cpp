@@ -1,28 +1,71 @@
 #include "server.hpp"
 #include "connection.hpp"
+#include "handoff.hpp"
 
-#include <asio/strand.hpp>
+#include <asio/post.hpp>
+#include <cx/logger.hpp>
+#include <iostream>
+#include <netinet/tcp.h>
 #include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <system_error>
 #include <thread>
+#include <unistd.h>
+
+static auto server_logger_v = cx::Logger{std::cout};
+
+namespace {
+
+// socket options asio has no portable name for
+using defer_accept = asio::detail::socket_option::integer<IPPROTO_TCP,
+                                                          TCP_DEFER_ACCEPT>;
+using fast_open =
+    asio::detail::socket_option::integer<IPPROTO_TCP, TCP_FASTOPEN>;
+
+// how often a draining server checks whether its connections are done
+constexpr auto drain_poll_interval_v = std::chrono::milliseconds{50};
+
+// protocol of a socket that was bound by another process
+asio::ip::tcp socket_protocol(int fd) {
+    sockaddr_storage address{};
+    socklen_t length = sizeof(address);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    return address.ss_family == AF_INET6 ? asio::ip::tcp::v6()
+                                         : asio::ip::tcp::v4();
+}
+
+} // namespace
 
 namespace http {
 
 Server::Server(std::string address, std::string port, std::string doc_root,
-               std::size_t thread_pool_size)
-    : signals{context}, acceptor{context}, thread_pool_size{thread_pool_size},
-      handler{doc_root} {
+               std::size_t thread_pool_size, std::optional<TlsConfig> tls,
+               std::vector<ProxyRoute> proxy_routes,
+               SocketOptions socket_options,
+               ConnectionOptions connection_options,
+               LifecycleOptions lifecycle_options, WarmUpOptions warm_up)
+    : strand{asio::make_strand(context)}, signals{strand}, acceptor{strand},
+      handoff_acceptor{strand}, drain_timer{strand},
+      thread_pool_size{thread_pool_size}, socket_options{socket_options},
+      connection_options{connection_options},
+      lifecycle_options{std::move(lifecycle_options)},
+      handler{doc_root, warm_up}, proxy{context, std::move(proxy_routes)} {
+    report_index();
+    if (tls) {
+        tls_context.emplace(make_tls_context(*tls));
+    }
+
     signals.add(SIGINT);
     signals.add(SIGTERM);
+    signals.add(SIGHUP);
 
-    do_await_stop();
+    do_await_signal();
 
-    auto resolver = asio::ip::tcp::resolver{context};
-    asio::ip::tcp::endpoint endpoint = *resolver.resolve(address, port).begin();
-
-    acceptor.open(endpoint.protocol());
-    acceptor.set_option(asio::ip::tcp::acceptor::reuse_address{true});
-    acceptor.bind(endpoint);
-    acceptor.listen();
+    listen(address, port);
+    if (!this->lifecycle_options.handoff_path.empty()) {
+        listen_for_handoff();
+    }
 
     do_accept();
 }
@@ -38,27 +81,227 @@ void Server::listen_and_serve() {
     }
 }
 
+void Server::listen(const std::string& address, const std::string& port) {
+    auto inherited = FileDescriptor{};
+    if (!lifecycle_options.handoff_path.empty()) {
+        inherited = receive_listener(lifecycle_options.handoff_path);
+    }
+
+    if (inherited) {
+        // already bound and listening, the server it came from drains now
+        const auto protocol = socket_protocol(inherited.get());
+        acceptor.assign(protocol, inherited.release());
+        server_logger_v.info("Took over listening socket from {}",
+                             lifecycle_options.handoff_path);
+    } else {
+        auto resolver = asio::ip::tcp::resolver{context};
+        asio::ip::tcp::endpoint endpoint =
+            *resolver.resolve(address, port).begin();
+
+        acceptor.open(endpoint.protocol());
+        acceptor.set_option(asio::ip::tcp::acceptor::reuse_address{true});
+        acceptor.bind(endpoint);
+    }
+
+    if (socket_options.defer_accept > 0) {
+        // only wake up for connections that have already sent data
+        acceptor.set_option(defer_accept{socket_options.defer_accept});
+    }
+    if (socket_options.fast_open_queue > 0) {
+        acceptor.set_option(fast_open{socket_options.fast_open_queue});
+    }
+    acceptor.listen();
+}
+
+void Server::listen_for_handoff() {
+    // the path is left behind by the server that was taken over from, or by
+    // one that didn't exit cleanly
+    const auto& path = lifecycle_options.handoff_path;
+    ::unlink(path.c_str());
+
+    const auto endpoint = asio::local::stream_protocol::endpoint{path};
+    handoff_acceptor.open(endpoint.protocol());
+    handoff_acceptor.bind(endpoint);
+    // connecting is refused until the socket listens, so restricting it to
+    // the server's user in between leaves no window for anyone else
+    if (::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0) {
+        throw std::system_error{errno, std::system_category(),
+                                "cannot restrict handoff socket " + path};
+    }
+    handoff_acceptor.listen();
+
+    do_accept_handoff();
+}
+
 void Server::do_accept() {
     acceptor.async_accept(
         asio::make_strand(context),
         [this](asio::error_code err, asio::ip::tcp::socket socket) {
-            //  if server was stopped by a signal, don't try to create more
-            //  connections
-            if (!acceptor.is_open()) {
+            if (!err) {
+                apply_socket_options(socket);
+
+                auto connection =
+                    tls_context
+                        ? std::make_shared<Connection>(
+                              Connection::TlsStream{std::move(socket),
+                                                    *tls_context},
+                              handler, proxy, buffers, connection_options)
+                        : std::make_shared<Connection>(
+                              std::move(socket), handler, proxy, buffers,
+                              connection_options);
+                connections.add(connection);
+                connection->start();
+            }
+
+            // closed once the server drains, so don't accept any more
+            // connections
+            if (acceptor.is_open()) {
+                do_accept();
+            }
+        });
+}
+
+void Server::do_accept_handoff() {
+    handoff_acceptor.async_accept(
+        [this](asio::error_code err,
+               asio::local::stream_protocol::socket socket) {
+            if (err) {
                 return;
             }
 
-            if (!err) {
-                std::make_shared<Connection>(std::move(socket), handler)
-                    ->start();
+            // whoever gets the listening socket takes over serving, and
+            // this server stops, so only a process of the same user may
+            if (!is_same_user(socket.native_handle())) {
+                server_logger_v.info(
+                    "Refused handoff to a process of another user");
+            } else if (send_listener(socket.native_handle(),
+                                     acceptor.native_handle())) {
+                server_logger_v.info("Handed listening socket over, draining");
+                drain();
+                return;
             }
-            do_accept();
+            do_accept_handoff();
         });
 }
 
-void Server::do_await_stop() {
-    signals.async_wait(
-        [this](asio::error_code /*err*/, int /*signal*/) { context.stop(); });
+void Server::apply_socket_options(tcp::socket& socket) const {
+    // failing to tune a connection isn't worth dropping it over
+    asio::error_code err;
+    std::ignore =
+        socket.set_option(tcp::no_delay{socket_options.no_delay}, err);
+    if (socket_options.send_buffer_size > 0) {
+        std::ignore = socket.set_option(
+            tcp::socket::send_buffer_size{socket_options.send_buffer_size},
+            err);
+    }
+}
+
+void Server::drain() {
+    if (draining) {
+        return;
+    }
+    draining = true;
+
+    asio::error_code err;
+    std::ignore = acceptor.close(err);
+    std::ignore = handoff_acceptor.close(err);
+    proxy.stop();
+    connections.stop_all();
+
+    drain_deadline =
+        std::chrono::steady_clock::now() + lifecycle_options.drain_timeout;
+    do_await_drained();
+}
+
+void Server::do_await_drained() {
+    const auto open = connections.size();
+    if (open == 0) {
+        context.stop();
+        return;
+    }
+    if (std::chrono::steady_clock::now() >= drain_deadline) {
+        server_logger_v.info("Drain timed out, closing {} connections", open);
+        context.stop();
+        return;
+    }
+
+    drain_timer.expires_after(drain_poll_interval_v);
+    drain_timer.async_wait([this](asio::error_code err) {
+        if (!err) {
+            do_await_drained();
+        }
+    });
+}
+
+void Server::reload() {
+    if (reloading) {
+        reload_pending = true;
+        return;
+    }
+    reloading = true;
+
+    // walking and preloading a large root takes a while, and accepting and
+    // draining mustn't wait for it. The previous reload has posted its result
+    // already, so joining it doesn't block
+    if (reload_thread.joinable()) {
+        reload_thread.join();
+    }
+    reload_thread = std::jthread{[this]() {
+        auto reloaded = handler.prepare_reload();
+        asio::post(strand, [this, reloaded = std::move(reloaded)]() mutable {
+            finish_reload(std::move(reloaded));
+        });
+    }};
+}
+
+void Server::finish_reload(
+    std::optional<RequestHandler::Reloaded> reloaded) {
+    reloading = false;
+    if (reloaded) {
+        handler.apply_reload(std::move(*reloaded));
+        server_logger_v.info("Reloaded document root");
+        report_index();
+    } else {
+        server_logger_v.error("Cannot reopen document root, keeping the old "
+                              "one");
+    }
+
+    if (reload_pending) { // the root may have changed again meanwhile
+        reload_pending = false;
+        reload();
+    }
+}
+
+void Server::report_index() const {
+    const auto index = handler.document_index();
+    if (!index) {
+        return;
+    }
+
+    const auto& stats = index->stats();
+    server_logger_v.info(
+        "Indexed {} files in {} ms, {} preloaded ({} KiB), index uses {} KiB",
+        stats.files, stats.elapsed.count(), stats.preloaded_files,
+        stats.preloaded_bytes / 1024, stats.memory / 1024);
+}
+
+void Server::do_await_signal() {
+    signals.async_wait([this](asio::error_code err, int signal) {
+        if (err) {
+            return;
+        }
+
+        if (signal == SIGHUP) {
+            reload();
+        } else if (draining) { // asked again, stop without waiting
+            context.stop();
+            return;
+        } else {
+            server_logger_v.info("Stopping, draining connections");
+            drain();
+        }
+        do_await_signal();
+    });
 }
 
 } // namespace http
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "tls.hpp"
+
+#include <openssl/ssl.h>
+#include <string_view>
+
+namespace http {
+
+namespace {
+
+// identifies sessions created by this server in the session cache
+constexpr std::string_view session_id_context_v = "http1asio";
+
+constexpr long session_cache_size_v = 20 * 1024;
+constexpr long session_timeout_seconds_v = 5 * 60;
+
+// protocols offered through ALPN in order of preference, as length prefixed
+// strings
+constexpr unsigned char alpn_protocols_v[] = "\x02h2\x08http/1.1";
+
+int select_alpn_protocol(SSL* /*ssl*/, const unsigned char** out,
+                         unsigned char* out_length, const unsigned char* in,
+                         unsigned int in_length, void* /*arg*/) {
+    auto result = SSL_select_next_proto(
+        const_cast<unsigned char**>(out), out_length, alpn_protocols_v,
+        sizeof(alpn_protocols_v) - 1, in, in_length);
+    return result == OPENSSL_NPN_NEGOTIATED ? SSL_TLSEXT_ERR_OK
+                                            : SSL_TLSEXT_ERR_NOACK;
+}
+
+} // namespace
+
+asio::ssl::context make_tls_context(const TlsConfig& config) {
+    asio::ssl::context context{asio::ssl::context::tls_server};
+    context.set_options(asio::ssl::context::default_workarounds |
+                        asio::ssl::context::no_sslv2 |
+                        asio::ssl::context::no_sslv3 |
+                        asio::ssl::context::no_tlsv1 |
+                        asio::ssl::context::no_tlsv1_1 |
+                        asio::ssl::context::single_dh_use);
+    context.use_certificate_chain_file(config.certificate_chain);
+    context.use_private_key_file(config.private_key, asio::ssl::context::pem);
+
+    auto* ctx = context.native_handle();
+
+    // resumption: TLS 1.2 clients resume from the session cache (or a ticket),
+    // TLS 1.3 clients through the tickets sent after the handshake
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, session_cache_size_v);
+    SSL_CTX_set_timeout(ctx, session_timeout_seconds_v);
+    SSL_CTX_set_session_id_context(
+        ctx, reinterpret_cast<const unsigned char*>(session_id_context_v.data()),
+        session_id_context_v.size());
+    SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+
+    SSL_CTX_set_alpn_select_cb(ctx, select_alpn_protocol, nullptr);
+
+#ifdef SSL_OP_ENABLE_KTLS
+    // OpenSSL silently keeps encrypting in userspace if the kernel or the
+    // negotiated cipher doesn't support kTLS
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+
+    return context;
+}
+
+} // namespace http
@@ -0,0 +1,55 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "buffer_pool.hpp"
+
+using http::BufferPool;
+
+TEST_CASE("Buffer pool - size classes") {
+    BufferPool pool;
+
+    REQUIRE(pool.acquire(1).size() == BufferPool::min_buffer_size_v);
+    REQUIRE(pool.acquire(512).size() == 512);
+    REQUIRE(pool.acquire(513).size() == 1024);
+    REQUIRE(pool.acquire(1 << 20).size() == BufferPool::max_buffer_size_v);
+}
+
+TEST_CASE("Buffer pool - released buffers are reused") {
+    BufferPool pool;
+
+    auto buffer = pool.acquire(2048);
+    const auto* data = buffer.data();
+    buffer.reset();
+    REQUIRE_FALSE(buffer);
+    REQUIRE(pool.acquire(2048).data() == data);
+
+    SECTION("Only by requests of the same size class") {
+        auto other = pool.acquire(4096);
+        REQUIRE(other.data() != data);
+    }
+
+    SECTION("Moving a buffer hands it back only once") {
+        auto first = pool.acquire(2048);
+        auto second = std::move(first);
+        first.reset();
+        REQUIRE(second.data() == data);
+        second.reset();
+        auto a = pool.acquire(2048);
+        auto b = pool.acquire(2048);
+        REQUIRE(a.data() == data);
+        REQUIRE(b.data() != data);
+    }
+}
+
+TEST_CASE("Buffer pool - free list is bounded") {
+    BufferPool pool{1};
+
+    auto a = pool.acquire(512);
+    auto b = pool.acquire(512);
+    const auto* kept = a.data();
+    a.reset();
+    b.reset(); // freed, the size class already holds one buffer
+
+    auto c = pool.acquire(512);
+    REQUIRE(c.data() == kept);
+}
@@ -0,0 +1,68 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "document_index.hpp"
+#include "file_descriptor.hpp"
+
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using http::DocumentIndex;
+using http::FileDescriptor;
+
+namespace {
+
+void write_file(const fs::path& path, std::string_view content) {
+    std::ofstream{path} << content;
+}
+
+} // namespace
+
+TEST_CASE("Document index - walks the whole root") {
+    const auto root = fs::temp_directory_path() /
+                      ("http-index-test-" + std::to_string(::getpid()));
+    fs::remove_all(root);
+    fs::create_directories(root / "a" / "b");
+    write_file(root / "index.html", "<html></html>");
+    write_file(root / "a" / "b" / "logo.png", "png");
+    write_file(root / "a" / "large.txt", std::string(100, 'x'));
+    fs::create_symlink(root / "index.html", root / "link.html");
+
+    auto fd = FileDescriptor{
+        ::open(root.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)};
+    REQUIRE(fd);
+
+    SECTION("Metadata of every regular file") {
+        const auto index = DocumentIndex::build(fd.get(), {.threads = 3});
+        REQUIRE(index->stats().files == 3);
+        REQUIRE(index->stats().preloaded_files == 0);
+
+        const auto* file = index->find("/a/b/logo.png");
+        REQUIRE(file);
+        REQUIRE(file->size == 3);
+        REQUIRE(file->mime_type == "image/png");
+        REQUIRE(file->etag == http::to_etag(file->size, file->modified));
+        REQUIRE_FALSE(file->preloaded);
+
+        REQUIRE(index->find("/index.html"));
+        REQUIRE_FALSE(index->find("/link.html")); // symlinks aren't indexed
+        REQUIRE_FALSE(index->find("/a"));
+        REQUIRE_FALSE(index->find("/missing"));
+    }
+
+    SECTION("Files are preloaded while they fit the budget") {
+        const auto index =
+            DocumentIndex::build(fd.get(), {.preload_budget = 20});
+        REQUIRE(index->stats().preloaded_files == 2);
+        REQUIRE(index->stats().preloaded_bytes == 16);
+        REQUIRE(index->find("/index.html")->content == "<html></html>");
+        REQUIRE_FALSE(index->find("/a/large.txt")->preloaded);
+        REQUIRE(index->stats().memory > index->stats().preloaded_bytes);
+    }
+
+    fs::remove_all(root);
+}
@@ -0,0 +1,97 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "handoff.hpp"
+
+#include <chrono>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+using http::FileDescriptor;
+
+namespace {
+
+int local_port(int fd) {
+    sockaddr_in address{};
+    socklen_t length = sizeof(address);
+    ::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+    return ntohs(address.sin_port);
+}
+
+} // namespace
+
+TEST_CASE("Listener handoff - socket is received by the new server") {
+    auto listener = FileDescriptor{::socket(AF_INET, SOCK_STREAM, 0)};
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(::bind(listener.get(), reinterpret_cast<sockaddr*>(&address),
+                   sizeof(address)) == 0);
+    REQUIRE(::listen(listener.get(), 16) == 0);
+
+    const auto path = "/tmp/http-handoff-test-" + std::to_string(::getpid());
+    ::unlink(path.c_str());
+
+    auto control = FileDescriptor{::socket(AF_UNIX, SOCK_STREAM, 0)};
+    sockaddr_un control_address{};
+    control_address.sun_family = AF_UNIX;
+    path.copy(control_address.sun_path, path.size());
+
+    SECTION("Nobody to take over from") {
+        REQUIRE_FALSE(http::receive_listener(path));
+    }
+
+    SECTION("A peer that never answers is given up on") {
+        REQUIRE(::bind(control.get(),
+                       reinterpret_cast<sockaddr*>(&control_address),
+                       sizeof(control_address)) == 0);
+        REQUIRE(::listen(control.get(), 1) == 0);
+
+        // connecting completes through the backlog, nothing is ever sent
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE_FALSE(
+            http::receive_listener(path, std::chrono::milliseconds{100}));
+        REQUIRE(std::chrono::steady_clock::now() - start <
+                std::chrono::seconds{5});
+        ::unlink(path.c_str());
+    }
+
+    SECTION("Handed over by a running server") {
+        REQUIRE(::bind(control.get(),
+                       reinterpret_cast<sockaddr*>(&control_address),
+                       sizeof(control_address)) == 0);
+        REQUIRE(::listen(control.get(), 1) == 0);
+
+        auto sent = false;
+        auto running = std::thread{[&]() {
+            auto successor = FileDescriptor{::accept(control.get(), nullptr,
+                                                     nullptr)};
+            sent = http::send_listener(successor.get(), listener.get());
+        }};
+
+        auto received = http::receive_listener(path);
+        running.join();
+
+        REQUIRE(sent);
+        REQUIRE(received);
+        REQUIRE(received.get() != listener.get());
+        REQUIRE(local_port(received.get()) == local_port(listener.get()));
+        ::unlink(path.c_str());
+    }
+}
+
+TEST_CASE("Listener handoff - peers of the same user are recognized") {
+    int pair[2];
+    REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    auto ours = FileDescriptor{pair[0]};
+    auto theirs = FileDescriptor{pair[1]};
+    REQUIRE(http::is_same_user(ours.get()));
+
+    // not a unix socket, so there are no credentials to check
+    auto tcp = FileDescriptor{::socket(AF_INET, SOCK_STREAM, 0)};
+    REQUIRE_FALSE(http::is_same_user(tcp.get()));
+}
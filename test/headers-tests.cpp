@@ -0,0 +1,72 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "headers.hpp"
+
+#include <cctype>
+#include <string>
+#include <vector>
+
+using http::Headers;
+using http::KnownHeader;
+
+TEST_CASE("Known headers - classification") {
+    for (auto i = 0uz; i < http::known_header_count_v; ++i) {
+        const auto header = static_cast<KnownHeader>(i);
+        const auto name = std::string{to_string(header)};
+        REQUIRE(http::to_known_header(name) == header);
+
+        auto lower = name;
+        for (auto& c : lower) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        REQUIRE(http::to_known_header(lower) == header);
+    }
+
+    REQUIRE(http::to_known_header("X-Custom") == std::nullopt);
+    REQUIRE(http::to_known_header("Hosts") == std::nullopt);
+    REQUIRE(http::to_known_header("") == std::nullopt);
+}
+
+TEST_CASE("Headers - lookup") {
+    Headers headers;
+    headers.add("content-length", "42");
+    headers.add("X-Request-Id", "abc");
+
+    REQUIRE(headers.contains(KnownHeader::ContentLength));
+    REQUIRE(headers.get(KnownHeader::ContentLength) == "42");
+    REQUIRE(headers.get("Content-Length") == "42");
+    REQUIRE(headers.get("x-request-id") == "abc");
+    REQUIRE_FALSE(headers.get(KnownHeader::Host));
+    REQUIRE_FALSE(headers.get("X-Missing"));
+    REQUIRE(headers.size() == 2);
+
+    SECTION("Repeated fields are combined") {
+        headers.add("Accept", "text/html");
+        headers.add("accept", "*/*");
+        headers.add("Cookie", "a=1");
+        headers.add("Cookie", "b=2");
+        headers.add("x-request-id", "def");
+        REQUIRE(headers.get(KnownHeader::Accept) == "text/html, */*");
+        REQUIRE(headers.get(KnownHeader::Cookie) == "a=1; b=2");
+        REQUIRE(headers.get("X-Request-Id") == "abc, def");
+        REQUIRE(headers.size() == 4);
+    }
+
+    SECTION("Every field is visited") {
+        std::vector<std::string> fields;
+        headers.for_each([&fields](std::string_view name,
+                                   std::string_view value) {
+            fields.push_back(std::string{name} + ": " + std::string{value});
+        });
+        REQUIRE(fields == std::vector<std::string>{"Content-Length: 42",
+                                                   "X-Request-Id: abc"});
+    }
+
+    SECTION("Clearing removes everything") {
+        headers.clear();
+        REQUIRE(headers.empty());
+        REQUIRE_FALSE(headers.get(KnownHeader::ContentLength));
+        REQUIRE_FALSE(headers.get("X-Request-Id"));
+    }
+}
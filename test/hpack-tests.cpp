@@ -0,0 +1,102 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "hpack.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+using http::Header;
+using http::hpack::Decoder;
+using http::hpack::Encoder;
+
+static auto from_hex(std::string_view hex) -> std::string {
+    std::string bytes;
+    for (auto i = 0uz; i + 1 < hex.size(); i += 2) {
+        bytes.push_back(
+            static_cast<char>(std::stoi(std::string{hex.substr(i, 2)}, {}, 16)));
+    }
+    return bytes;
+}
+
+static auto header_value(const std::vector<Header>& headers,
+                         std::string_view name) -> std::string {
+    for (auto& h : headers) {
+        if (h.name == name)
+            return h.value;
+    }
+    return {};
+}
+
+TEST_CASE("HPACK Decoder - RFC 7541 C.4 requests with Huffman coding") {
+    Decoder decoder;
+    std::vector<Header> headers;
+
+    REQUIRE(decoder.decode(from_hex("828684418cf1e3c2e5f23a6ba0ab90f4ff"),
+                           headers));
+    REQUIRE(headers.size() == 4);
+    REQUIRE(header_value(headers, ":method") == "GET");
+    REQUIRE(header_value(headers, ":path") == "/");
+    REQUIRE(header_value(headers, ":authority") == "www.example.com");
+
+    // refers to the :authority added to the dynamic table by the first block
+    headers.clear();
+    REQUIRE(decoder.decode(from_hex("828684be5886a8eb10649cbf"), headers));
+    REQUIRE(headers.size() == 5);
+    REQUIRE(header_value(headers, ":authority") == "www.example.com");
+    REQUIRE(header_value(headers, "cache-control") == "no-cache");
+
+    headers.clear();
+    REQUIRE(decoder.decode(
+        from_hex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"),
+        headers));
+    REQUIRE(header_value(headers, ":scheme") == "https");
+    REQUIRE(header_value(headers, ":path") == "/index.html");
+    REQUIRE(header_value(headers, "custom-key") == "custom-value");
+}
+
+TEST_CASE("HPACK Decoder - invalid blocks") {
+    Decoder decoder;
+    std::vector<Header> headers;
+
+    SECTION("Index out of range") {
+        REQUIRE_FALSE(decoder.decode(from_hex("be"), headers));
+    }
+
+    SECTION("Index zero") {
+        REQUIRE_FALSE(decoder.decode(from_hex("80"), headers));
+    }
+
+    SECTION("Truncated string literal") {
+        REQUIRE_FALSE(decoder.decode(from_hex("410a6162"), headers));
+    }
+
+    SECTION("Table size update larger than allowed") {
+        REQUIRE_FALSE(decoder.decode(from_hex("3fe23f"), headers));
+    }
+}
+
+TEST_CASE("HPACK Encoder - round trip through the dynamic table") {
+    Encoder encoder;
+    Decoder decoder;
+
+    for (auto i = 0; i < 2; ++i) {
+        std::string block;
+        encoder.begin_block(block);
+        encoder.encode(":status", "200", block);
+        encoder.encode("content-type", "text/html", block);
+        encoder.encode("content-length", "42", block);
+
+        std::vector<Header> headers;
+        REQUIRE(decoder.decode(block, headers));
+        REQUIRE(headers.size() == 3);
+        REQUIRE(header_value(headers, ":status") == "200");
+        REQUIRE(header_value(headers, "content-type") == "text/html");
+        REQUIRE(header_value(headers, "content-length") == "42");
+
+        if (i == 1) { // only indexed references are left for content-type
+            REQUIRE(block.size() < 10);
+        }
+    }
+}
@@ -0,0 +1,462 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "hpack.hpp"
+#include "http2.hpp"
+#include "proxy.hpp"
+#include "request_handler.hpp"
+
+#include <asio/io_context.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+using http::Header;
+using http::http2::client_preface_v;
+using http::http2::Session;
+
+namespace {
+
+// RFC 9113 frame types, flags and error codes the tests look at
+namespace type {
+constexpr std::uint8_t data = 0x0;
+constexpr std::uint8_t headers = 0x1;
+constexpr std::uint8_t rst_stream = 0x3;
+constexpr std::uint8_t settings = 0x4;
+constexpr std::uint8_t ping = 0x6;
+constexpr std::uint8_t goaway = 0x7;
+constexpr std::uint8_t window_update = 0x8;
+constexpr std::uint8_t continuation = 0x9;
+} // namespace type
+
+constexpr std::uint8_t end_stream = 0x1;
+constexpr std::uint8_t ack = 0x1;
+constexpr std::uint8_t end_headers = 0x4;
+constexpr std::uint8_t priority = 0x20;
+
+namespace error {
+constexpr std::uint32_t no_error = 0x0;
+constexpr std::uint32_t protocol = 0x1;
+constexpr std::uint32_t flow_control = 0x3;
+constexpr std::uint32_t refused_stream = 0x7;
+constexpr std::uint32_t http_1_1_required = 0xd;
+} // namespace error
+
+constexpr std::uint16_t initial_window_size = 0x4;
+
+constexpr std::size_t large_file_size_v = 100'000;
+
+struct Frame {
+    std::uint8_t type;
+    std::uint8_t flags;
+    std::uint32_t stream_id;
+    std::string payload;
+};
+
+auto u32(std::uint32_t value) -> std::string {
+    return {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+            static_cast<char>(value >> 8), static_cast<char>(value)};
+}
+
+auto read_u32(std::string_view bytes) -> std::uint32_t {
+    return static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[0]))
+               << 24 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[1]))
+               << 16 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[2]))
+               << 8 |
+           static_cast<std::uint32_t>(static_cast<unsigned char>(bytes[3]));
+}
+
+auto frame(std::uint8_t frame_type, std::uint8_t flags,
+           std::uint32_t stream_id, std::string_view payload = {})
+    -> std::string {
+    auto bytes = u32(static_cast<std::uint32_t>(payload.size()) << 8 |
+                     frame_type);
+    bytes.push_back(static_cast<char>(flags));
+    bytes += u32(stream_id);
+    bytes += payload;
+    return bytes;
+}
+
+auto setting(std::uint16_t id, std::uint32_t value) -> std::string {
+    return std::string{static_cast<char>(id >> 8), static_cast<char>(id)} +
+           u32(value);
+}
+
+auto window_update(std::uint32_t stream_id, std::uint32_t increment)
+    -> std::string {
+    return frame(type::window_update, 0, stream_id, u32(increment));
+}
+
+// error code of a GOAWAY or RST_STREAM frame
+auto error_code(const Frame& frame) -> std::uint32_t {
+    return read_u32(std::string_view{frame.payload}.substr(
+        frame.type == type::goaway ? 4 : 0));
+}
+
+// Document root with a small index and a file larger than the initial flow
+// control window, shared by every test
+auto handler() -> http::RequestHandler& {
+    static auto handler = [] {
+        const auto root = fs::temp_directory_path() /
+                          ("http2-test-" + std::to_string(::getpid()));
+        fs::remove_all(root);
+        fs::create_directories(root);
+        std::ofstream{root / "index.html"} << "<html></html>";
+        std::ofstream{root / "large.bin"}
+            << std::string(large_file_size_v, 'x');
+        return std::make_unique<http::RequestHandler>(root.string());
+    }();
+    return *handler;
+}
+
+auto proxy() -> http::ProxyHandler& {
+    static asio::io_context context;
+    static http::ProxyHandler proxy{context,
+                                    {{"/api", {{"127.0.0.1", "1"}}}}};
+    return proxy;
+}
+
+// The client end of a session: encodes requests into frames, and takes the
+// frames the session answers with, decoding response headers on the way
+class Peer {
+  public:
+    Peer() : session{handler(), proxy()} {}
+
+    bool send(std::string_view bytes) { return session.consume(bytes); }
+
+    // send the preface with settings, and take the server's settings and ACK
+    void start(std::string_view settings = {}) {
+        REQUIRE(send(std::string{client_preface_v} +
+                     frame(type::settings, 0, 0, settings)));
+        take();
+    }
+
+    auto request(std::uint32_t stream_id, std::string_view path,
+                 std::uint8_t flags = end_stream | end_headers,
+                 int weight = 16) -> std::string {
+        std::string block;
+        encoder.begin_block(block);
+        encoder.encode(":method", "GET", block);
+        encoder.encode(":scheme", "https", block);
+        encoder.encode(":path", path, block);
+        encoder.encode(":authority", "example.com", block);
+        if (flags & priority) {
+            block = u32(0) + static_cast<char>(weight - 1) + block;
+        }
+        return frame(type::headers, flags, stream_id, block);
+    }
+
+    // frames from a single next_output() call
+    auto take_once() -> std::vector<Frame> {
+        std::vector<Frame> frames;
+        std::string_view output = session.next_output();
+        while (output.size() >= 9) {
+            const auto length = read_u32(output) >> 8;
+            Frame f{
+                .type = static_cast<std::uint8_t>(output[3]),
+                .flags = static_cast<std::uint8_t>(output[4]),
+                .stream_id = read_u32(output.substr(5)) & 0x7fffffff,
+                .payload = std::string{output.substr(9, length)},
+            };
+            if (f.type == type::headers) {
+                std::vector<Header> fields;
+                REQUIRE(decoder.decode(f.payload, fields));
+                statuses[f.stream_id] = fields.at(0).value;
+            }
+            if (f.type == type::data) {
+                bodies[f.stream_id] += f.payload;
+            }
+            frames.push_back(std::move(f));
+            output.remove_prefix(9 + length);
+        }
+        session.output_written();
+        return frames;
+    }
+
+    // every frame the session has to send
+    auto take() -> std::vector<Frame> {
+        std::vector<Frame> frames;
+        for (auto more = take_once(); !more.empty(); more = take_once()) {
+            frames.insert(frames.end(), more.begin(), more.end());
+        }
+        return frames;
+    }
+
+    Session session;
+    std::map<std::uint32_t, std::string> statuses; // :status by stream
+    std::map<std::uint32_t, std::string> bodies;   // DATA by stream
+
+  private:
+    http::hpack::Encoder encoder;
+    http::hpack::Decoder decoder;
+};
+
+auto find(const std::vector<Frame>& frames, std::uint8_t frame_type)
+    -> const Frame* {
+    for (const auto& f : frames) {
+        if (f.type == frame_type) {
+            return &f;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+TEST_CASE("HTTP/2 - connection preface") {
+    Peer peer;
+
+    SECTION("Settings are exchanged and acknowledged") {
+        REQUIRE(peer.send(std::string{client_preface_v} +
+                          frame(type::settings, 0, 0)));
+        const auto frames = peer.take();
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0].type == type::settings);
+        REQUIRE_FALSE(frames[0].flags & ack);
+        REQUIRE(frames[1].type == type::settings);
+        REQUIRE(frames[1].flags & ack);
+    }
+
+    SECTION("Anything else fails the connection") {
+        REQUIRE_FALSE(peer.send("GET / HTTP/1.1\r\n\r\n"));
+        const auto frames = peer.take();
+        const auto* goaway = find(frames, type::goaway);
+        REQUIRE(goaway);
+        REQUIRE(error_code(*goaway) == error::protocol);
+        REQUIRE(peer.session.finished());
+    }
+
+    SECTION("The preface has to be followed by SETTINGS") {
+        REQUIRE_FALSE(peer.send(std::string{client_preface_v} +
+                                frame(type::ping, 0, 0, std::string(8, 0))));
+        REQUIRE(error_code(*find(peer.take(), type::goaway)) ==
+                error::protocol);
+    }
+}
+
+TEST_CASE("HTTP/2 - requests") {
+    Peer peer;
+    peer.start();
+
+    SECTION("Response headers and body") {
+        REQUIRE(peer.send(peer.request(1, "/index.html")));
+        const auto frames = peer.take();
+        REQUIRE(frames.size() == 2);
+        REQUIRE(frames[0].type == type::headers);
+        REQUIRE(frames[1].type == type::data);
+        REQUIRE(frames[1].flags & end_stream);
+        REQUIRE(peer.statuses[1] == "200");
+        REQUIRE(peer.bodies[1] == "<html></html>");
+    }
+
+    SECTION("A stock response ends the stream with its headers") {
+        REQUIRE(peer.send(peer.request(1, "/missing.html")));
+        peer.take();
+        REQUIRE(peer.statuses[1] == "404");
+    }
+
+    SECTION("Header blocks continue in CONTINUATION frames") {
+        auto headers = peer.request(1, "/index.html", end_stream);
+        const auto block = headers.substr(9);
+        headers = frame(type::headers, end_stream, 1, block.substr(0, 5));
+        REQUIRE(peer.send(headers));
+        REQUIRE(peer.take().empty());
+
+        REQUIRE(peer.send(frame(type::continuation, end_headers, 1,
+                                block.substr(5))));
+        peer.take();
+        REQUIRE(peer.statuses[1] == "200");
+    }
+
+    SECTION("Nothing may come between HEADERS and CONTINUATION") {
+        REQUIRE(peer.send(peer.request(1, "/index.html", end_stream)));
+        REQUIRE_FALSE(peer.send(frame(type::ping, 0, 0, std::string(8, 0))));
+        REQUIRE(error_code(*find(peer.take(), type::goaway)) ==
+                error::protocol);
+    }
+
+    SECTION("A request ends with its body, or with trailers") {
+        REQUIRE(peer.send(peer.request(1, "/index.html", end_headers)));
+        REQUIRE(peer.send(frame(type::data, 0, 1, "body")));
+        auto frames = peer.take();
+        REQUIRE(find(frames, type::window_update)); // body is discarded
+        REQUIRE_FALSE(find(frames, type::headers));
+
+        // trailers, decoded against the same header table
+        REQUIRE(peer.send(peer.request(1, "/ignored",
+                                       end_stream | end_headers)));
+        peer.take();
+        REQUIRE(peer.statuses[1] == "200");
+        REQUIRE(peer.bodies[1] == "<html></html>");
+    }
+
+    SECTION("Trailers have to end the stream") {
+        REQUIRE(peer.send(peer.request(1, "/index.html", end_headers)));
+        REQUIRE_FALSE(peer.send(peer.request(1, "/index.html", end_headers)));
+        REQUIRE(error_code(*find(peer.take(), type::goaway)) ==
+                error::protocol);
+    }
+
+    SECTION("Proxied paths are sent back to HTTP/1.1") {
+        REQUIRE(peer.send(peer.request(1, "/api/users")));
+        const auto frames = peer.take();
+        const auto* reset = find(frames, type::rst_stream);
+        REQUIRE(reset);
+        REQUIRE(error_code(*reset) == error::http_1_1_required);
+    }
+}
+
+TEST_CASE("HTTP/2 - stream errors") {
+    Peer peer;
+    peer.start();
+
+    SECTION("DATA on a stream that was never opened") {
+        REQUIRE_FALSE(peer.send(frame(type::data, 0, 5, "data")));
+        REQUIRE(error_code(*find(peer.take(), type::goaway)) ==
+                error::protocol);
+    }
+
+    SECTION("Stream ids have to increase") {
+        REQUIRE(peer.send(peer.request(3, "/index.html")));
+        REQUIRE_FALSE(peer.send(peer.request(1, "/index.html")));
+        REQUIRE(error_code(*find(peer.take(), type::goaway)) ==
+                error::protocol);
+    }
+
+    SECTION("Streams past the concurrency limit are refused") {
+        for (std::uint32_t id = 1; id <= 199; id += 2) { // 100 open streams
+            REQUIRE(peer.send(peer.request(id, "/index.html", end_headers)));
+        }
+        REQUIRE(peer.send(peer.request(201, "/index.html", end_headers)));
+
+        const auto frames = peer.take();
+        REQUIRE(frames.size() == 1);
+        REQUIRE(frames[0].type == type::rst_stream);
+        REQUIRE(frames[0].stream_id == 201);
+        REQUIRE(error_code(frames[0]) == error::refused_stream);
+    }
+}
+
+TEST_CASE("HTTP/2 - flow control") {
+    Peer peer;
+
+    SECTION("DATA stops at the windows and resumes with WINDOW_UPDATE") {
+        peer.start();
+        REQUIRE(peer.send(peer.request(1, "/large.bin")));
+        peer.take();
+        REQUIRE(peer.bodies[1].size() == 65535);
+
+        // the stream window is still exhausted
+        REQUIRE(peer.send(window_update(0, large_file_size_v)));
+        REQUIRE(peer.take().empty());
+
+        REQUIRE(peer.send(window_update(1, large_file_size_v)));
+        const auto frames = peer.take();
+        REQUIRE(frames.back().flags & end_stream);
+        REQUIRE(peer.bodies[1].size() == large_file_size_v);
+    }
+
+    SECTION("SETTINGS_INITIAL_WINDOW_SIZE changes open streams too") {
+        peer.start(setting(initial_window_size, 1000));
+        REQUIRE(peer.send(peer.request(1, "/large.bin")));
+        peer.take();
+        REQUIRE(peer.bodies[1].size() == 1000);
+
+        REQUIRE(peer.send(frame(type::settings, 0, 0,
+                                setting(initial_window_size, 3000))));
+        const auto frames = peer.take();
+        REQUIRE(frames.front().type == type::settings);
+        REQUIRE(frames.front().flags & ack);
+        REQUIRE(peer.bodies[1].size() == 3000);
+    }
+
+    SECTION("Windows can't grow past 2^31-1") {
+        peer.start();
+        REQUIRE_FALSE(peer.send(window_update(0, 0x7fffffff)));
+        REQUIRE(error_code(*find(peer.take(), type::goaway)) ==
+                error::flow_control);
+    }
+
+    SECTION("Nor through a larger initial window") {
+        peer.start();
+        REQUIRE(peer.send(peer.request(1, "/large.bin", end_headers)));
+        REQUIRE(peer.send(window_update(1, 0x7fffffff - 65535)));
+        REQUIRE_FALSE(peer.send(frame(type::settings, 0, 0,
+                                      setting(initial_window_size, 65536))));
+        REQUIRE(error_code(*find(peer.take(), type::goaway)) ==
+                error::flow_control);
+    }
+}
+
+TEST_CASE("HTTP/2 - streams share bandwidth by weight") {
+    Peer peer;
+    peer.start();
+    REQUIRE(peer.send(window_update(0, 1'000'000)));
+    REQUIRE(peer.send(
+        peer.request(1, "/large.bin", end_stream | end_headers | priority, 1)));
+    REQUIRE(peer.send(peer.request(
+        3, "/large.bin", end_stream | end_headers | priority, 256)));
+
+    // both start out even, after that the heavier stream is served almost
+    // exclusively
+    peer.take_once();
+    REQUIRE(peer.bodies[3].size() >= 3 * peer.bodies[1].size());
+
+    // and both complete once the windows allow it
+    REQUIRE(peer.send(window_update(1, large_file_size_v)));
+    REQUIRE(peer.send(window_update(3, large_file_size_v)));
+    peer.take();
+    REQUIRE(peer.bodies[1].size() == large_file_size_v);
+    REQUIRE(peer.bodies[3].size() == large_file_size_v);
+}
+
+TEST_CASE("HTTP/2 - control frame floods back up the output") {
+    Peer peer;
+    peer.start();
+
+    std::string pings;
+    for (auto i = 0; i < 10'000; ++i) {
+        pings += frame(type::ping, 0, 0, std::string(8, 'p'));
+    }
+    REQUIRE(peer.send(pings));
+    REQUIRE(peer.session.backlogged());
+
+    // handed out, but not written yet
+    std::ignore = peer.session.next_output();
+    REQUIRE(peer.session.backlogged());
+
+    peer.take();
+    REQUIRE_FALSE(peer.session.backlogged());
+}
+
+TEST_CASE("HTTP/2 - going away") {
+    Peer peer;
+    peer.start();
+    REQUIRE(peer.send(peer.request(1, "/large.bin")));
+    peer.session.go_away();
+
+    auto frames = peer.take();
+    const auto* goaway = find(frames, type::goaway);
+    REQUIRE(goaway);
+    REQUIRE(error_code(*goaway) == error::no_error);
+    REQUIRE(read_u32(goaway->payload) == 1); // last stream served
+
+    // new streams are ignored, the open one completes
+    REQUIRE(peer.send(peer.request(3, "/index.html")));
+    REQUIRE(peer.send(window_update(0, large_file_size_v)));
+    REQUIRE(peer.send(window_update(1, large_file_size_v)));
+    frames = peer.take();
+    REQUIRE(frames.back().stream_id == 1);
+    REQUIRE(frames.back().flags & end_stream);
+    REQUIRE_FALSE(peer.statuses.contains(3));
+    REQUIRE(peer.session.finished());
+}
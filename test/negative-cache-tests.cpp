@@ -0,0 +1,53 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "negative_cache.hpp"
+
+#include <chrono>
+#include <thread>
+
+using http::NegativeCache;
+using namespace std::chrono_literals;
+
+TEST_CASE("Negative cache - remembers missing paths") {
+    NegativeCache cache{4, 1min};
+    REQUIRE_FALSE(cache.contains("/missing.html"));
+
+    cache.insert("/missing.html");
+    REQUIRE(cache.contains("/missing.html"));
+    REQUIRE_FALSE(cache.contains("/other.html"));
+
+    cache.clear();
+    REQUIRE_FALSE(cache.contains("/missing.html"));
+}
+
+TEST_CASE("Negative cache - entries expire") {
+    NegativeCache cache{4, 10ms};
+    cache.insert("/missing.html");
+    std::this_thread::sleep_for(20ms);
+    REQUIRE_FALSE(cache.contains("/missing.html"));
+
+    // seen missing again, with a new deadline
+    cache.insert("/missing.html");
+    REQUIRE(cache.contains("/missing.html"));
+}
+
+TEST_CASE("Negative cache - the oldest path is evicted at capacity") {
+    NegativeCache cache{2, 1min};
+    cache.insert("/a");
+    cache.insert("/a"); // not counted twice
+    cache.insert("/b");
+    REQUIRE(cache.contains("/a"));
+    REQUIRE(cache.contains("/b"));
+
+    cache.insert("/c");
+    REQUIRE_FALSE(cache.contains("/a"));
+    REQUIRE(cache.contains("/b"));
+    REQUIRE(cache.contains("/c"));
+}
+
+TEST_CASE("Negative cache - a capacity of 0 disables it") {
+    NegativeCache cache{0, 1min};
+    cache.insert("/missing.html");
+    REQUIRE_FALSE(cache.contains("/missing.html"));
+}
@@ -11,11 +11,7 @@ using http::RequestParser;
 
 static auto header_value(const Request& req, std::string_view name)
     -> std::string {
-    for (auto& h : req.headers) {
-        if (h.name == name)
-            return h.value;
-    }
-    return {};
+    return std::string{req.headers.get(name).value_or("")};
 }
 
 TEST_CASE("HTTP/1.0 Parser - complete request") {
@@ -40,6 +36,23 @@ TEST_CASE("HTTP/1.0 Parser - complete request") {
     REQUIRE(req.headers.size() == 2);
 }
 
+TEST_CASE("HTTP/1.0 Parser - header names are case-insensitive") {
+    RequestParser parser;
+    Request req;
+
+    constexpr std::string_view input = "GET / HTTP/1.0\r\n"
+                                       "host: example.com\r\n"
+                                       "X-Custom: a\r\n"
+                                       "x-custom: b\r\n"
+                                       "\r\n";
+
+    REQUIRE(parser.parse(req, input) == RequestParser::Result::Complete);
+    REQUIRE(req.headers.get(http::KnownHeader::Host) == "example.com");
+    REQUIRE(header_value(req, "HOST") == "example.com");
+    REQUIRE(header_value(req, "X-CUSTOM") == "a, b");
+    REQUIRE(req.headers.size() == 2);
+}
+
 TEST_CASE("HTTP/1.0 Parser - incomplete (Indeterminate) request") {
     RequestParser parser;
     Request req;
@@ -83,6 +96,13 @@ TEST_CASE("HTTP/1.0 Parser - invalid requests") {
         REQUIRE(result == RequestParser::Result::Invalid);
     }
 
+    SECTION("Overlong HTTP version") {
+        constexpr std::string_view input =
+            "GET / HTTP/1.99999999999999999999\r\n\r\n";
+        auto result = parser.parse(req, input);
+        REQUIRE(result == RequestParser::Result::Invalid);
+    }
+
     SECTION("Malformed header") {
         constexpr std::string_view input = "GET /index.html HTTP/1.0\r\n"
                                            "BadHeader\r\n"
@@ -128,3 +148,33 @@ TEST_CASE("HTTP/1.0 Parser - empty input") {
     auto r = parser.parse(req, "");
     REQUIRE(r == RequestParser::Result::Indeterminate);
 }
+
+TEST_CASE("HTTP/1.0 Parser - header size limit") {
+    constexpr std::string_view input = "GET / HTTP/1.0\r\n"
+                                       "Cookie: aaaaaaaaaaaaaaaa\r\n"
+                                       "\r\n";
+
+    SECTION("Requests up to the limit are accepted") {
+        RequestParser parser{input.size()};
+        Request req;
+        REQUIRE(parser.parse(req, input) == RequestParser::Result::Complete);
+    }
+
+    SECTION("Larger requests are rejected, even when split up") {
+        RequestParser parser{input.size() - 1};
+        Request req;
+        REQUIRE(parser.parse(req, input.substr(0, 20)) ==
+                RequestParser::Result::Indeterminate);
+        REQUIRE(parser.parse(req, input.substr(20)) ==
+                RequestParser::Result::TooLarge);
+    }
+
+    SECTION("The limit applies to each request separately") {
+        RequestParser parser{input.size()};
+        Request req;
+        REQUIRE(parser.parse(req, input) == RequestParser::Result::Complete);
+        parser.reset();
+        Request next;
+        REQUIRE(parser.parse(next, input) == RequestParser::Result::Complete);
+    }
+}
@@ -0,0 +1,318 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "proxy.hpp"
+#include "request.hpp"
+
+#include <asio/read_until.hpp>
+#include <asio/write.hpp>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+using asio::ip::tcp;
+using http::ProxyHandler;
+using http::ProxyRoute;
+using http::Request;
+
+// Stand-in upstream on loopback that answers keep-alive connections one at a
+// time: /api/chunked with a chunked body, /api/bad-length with a malformed
+// Content-Length, /api/early-hints with a 103 ahead of the response, everything
+// else with Content-Length (and HEAD without body)
+class Backend {
+  public:
+    Backend() : acceptor{context, {asio::ip::make_address("127.0.0.1"), 0}} {
+        thread = std::thread{[this] { serve(); }};
+    }
+
+    // the proxy has to be gone already, so no pooled connection is open
+    ~Backend() {
+        stopping = true;
+        asio::error_code err;
+        tcp::socket wake_up{context};
+        wake_up.connect(acceptor.local_endpoint(), err);
+        thread.join();
+    }
+
+    auto port() const -> std::string {
+        return std::to_string(acceptor.local_endpoint().port());
+    }
+
+    std::atomic<int> connections = 0;
+
+    // the head of the request answered last
+    auto last_request() -> std::string {
+        std::lock_guard lock{mutex};
+        return last;
+    }
+
+  private:
+    void serve() {
+        for (;;) {
+            asio::error_code err;
+            auto socket = acceptor.accept(err);
+            if (err || stopping) {
+                return;
+            }
+            ++connections;
+
+            std::string data;
+            for (;;) {
+                auto n = asio::read_until(socket, asio::dynamic_buffer(data),
+                                          "\r\n\r\n", err);
+                if (err) {
+                    break;
+                }
+                const auto request = data.substr(0, n);
+                data.erase(0, n);
+                {
+                    std::lock_guard lock{mutex};
+                    last = request;
+                }
+
+                auto response = std::string{"HTTP/1.1 200 OK\r\n"
+                                            "Content-Length: 5\r\n"
+                                            "Keep-Alive: timeout=5\r\n"
+                                            "\r\n"};
+                if (request.starts_with("GET /api/chunked ")) {
+                    response = "HTTP/1.1 200 OK\r\n"
+                               "Transfer-Encoding: chunked\r\n"
+                               "\r\n"
+                               "5\r\nhello\r\n"
+                               "7;ext=1\r\n, world\r\n"
+                               "0\r\n\r\n";
+                } else if (request.starts_with("GET /api/bad-length ")) {
+                    response = "HTTP/1.1 200 OK\r\n"
+                               "Content-Length: 5x\r\n"
+                               "\r\n"
+                               "hello";
+                } else if (request.starts_with("GET /api/early-hints ")) {
+                    // the interim head goes out on its own, ahead of the rest
+                    asio::write(socket,
+                                asio::buffer(std::string_view{
+                                    "HTTP/1.1 103 Early Hints\r\n"
+                                    "Link: </style.css>; rel=preload\r\n"
+                                    "\r\n"}),
+                                err);
+                    response += "hello";
+                } else if (!request.starts_with("HEAD ")) {
+                    response += "hello";
+                }
+                asio::write(socket, asio::buffer(response), err);
+            }
+        }
+    }
+
+    asio::io_context context;
+    tcp::acceptor acceptor;
+    std::atomic<bool> stopping = false;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::string last; // guarded by mutex, written by the backend thread
+};
+
+static auto make_request(std::string uri) -> Request {
+    Request req;
+    req.method = "GET";
+    req.uri = std::move(uri);
+    req.version = {1, 0};
+    req.headers.add("Host", "example.com");
+    req.headers.add("Connection", "close");
+    return req;
+}
+
+static auto matches(const ProxyHandler& proxy, const Request& req)
+    -> bool {
+    std::string path;
+    return proxy.matches(req, path);
+}
+
+// forward req and run the context until the whole response was written
+static auto forward(asio::io_context& context, ProxyHandler& proxy,
+                    const Request& req) -> std::string {
+    std::string path;
+    REQUIRE(proxy.matches(req, path));
+
+    std::string response;
+    bool finished = false;
+    proxy.forward(req, path, "127.0.0.1", context.get_executor(),
+                  http::ProxySink{
+                      .write =
+                          [&](std::string_view chunk,
+                              std::function<void(bool)> done) {
+                              response.append(chunk);
+                              done(true);
+                          },
+                      .finish = [&] { finished = true; },
+                  });
+    while (!finished) {
+        context.run_one();
+    }
+    return response;
+}
+
+TEST_CASE("Proxy - route matching") {
+    asio::io_context context;
+    ProxyHandler proxy{context, {{"/api", {{"127.0.0.1", "1"}}}}};
+
+    REQUIRE(matches(proxy, make_request("/api")));
+    REQUIRE(matches(proxy, make_request("/api/users")));
+    REQUIRE(matches(proxy, make_request("/api?q=1")));
+    REQUIRE_FALSE(matches(proxy, make_request("/apiary")));
+    REQUIRE_FALSE(matches(proxy, make_request("/index.html")));
+
+    SECTION("Paths are matched once normalized") {
+        std::string path;
+        REQUIRE(proxy.matches(make_request("//api/./users?q=1"), path));
+        REQUIRE(path == "/api/users");
+
+        REQUIRE(matches(proxy, make_request("//api/./users")));
+        REQUIRE(matches(proxy, make_request("/%61pi")));
+        REQUIRE_FALSE(matches(proxy, make_request("/api/../admin")));
+        REQUIRE_FALSE(matches(proxy, make_request("/api/%2e%2e/admin")));
+        REQUIRE_FALSE(matches(proxy, make_request("/api/%zz")));
+    }
+
+    SECTION("Without routes nothing matches") {
+        ProxyHandler none{context, {}};
+        REQUIRE_FALSE(matches(none, make_request("/api")));
+    }
+}
+
+TEST_CASE("Proxy - responses are relayed from a local backend") {
+    Backend backend;
+    asio::io_context context;
+    ProxyHandler proxy{context, {{"/api", {{"127.0.0.1", backend.port()}}}}};
+
+    SECTION("Content-Length body") {
+        auto response = forward(context, proxy, make_request("/api/length"));
+        REQUIRE(response == "HTTP/1.0 200 OK\r\n"
+                            "Content-Length: 5\r\n"
+                            "\r\n"
+                            "hello");
+
+        // hop-by-hop fields are dropped, the client is reported upstream
+        const auto request = backend.last_request();
+        REQUIRE(request.starts_with(
+            "GET /api/length HTTP/1.1\r\nHost: example.com\r\n"));
+        REQUIRE(request.find("Connection: close") == std::string::npos);
+        REQUIRE(request.find("X-Forwarded-For: 127.0.0.1") !=
+                std::string::npos);
+    }
+
+    SECTION("The normalized path is forwarded, with the query as is") {
+        forward(context, proxy, make_request("//api/./a%2Bb/?q=%2e%2e"));
+        REQUIRE(backend.last_request().starts_with(
+            "GET /api/a%2Bb/?q=%2e%2e HTTP/1.1\r\n"));
+    }
+
+    SECTION("Chunked body is decoded for HTTP/1.0 clients") {
+        auto response = forward(context, proxy, make_request("/api/chunked"));
+        REQUIRE(response == "HTTP/1.0 200 OK\r\n"
+                            "\r\n"
+                            "hello, world");
+    }
+
+    SECTION("Requests with a body are refused, the body can't be relayed") {
+        auto req = make_request("/api/length");
+        req.method = "POST";
+        req.headers.add("Content-Length", "5");
+        auto response = forward(context, proxy, req);
+        REQUIRE(response.starts_with("HTTP/1.0 501"));
+        REQUIRE(backend.connections == 0);
+
+        req.headers.clear();
+        req.headers.add("Content-Length", "0");
+        response = forward(context, proxy, req);
+        REQUIRE(response.starts_with("HTTP/1.0 200"));
+        REQUIRE(backend.last_request().find("Content-Length") ==
+                std::string::npos);
+    }
+
+    SECTION("Responses to HEAD have no body, whatever they announce") {
+        auto req = make_request("/api/length");
+        req.method = "HEAD";
+        auto response = forward(context, proxy, req);
+        REQUIRE(response == "HTTP/1.0 200 OK\r\n"
+                            "Content-Length: 5\r\n"
+                            "\r\n");
+
+        // and the upstream connection is still in step
+        response = forward(context, proxy, make_request("/api/length"));
+        REQUIRE(response.ends_with("\r\n\r\nhello"));
+        REQUIRE(backend.connections == 1);
+    }
+
+    SECTION("Interim responses are dropped, the final one is relayed") {
+        auto response =
+            forward(context, proxy, make_request("/api/early-hints"));
+        REQUIRE(response == "HTTP/1.0 200 OK\r\n"
+                            "Content-Length: 5\r\n"
+                            "\r\n"
+                            "hello");
+
+        // and the upstream connection is still in step
+        response = forward(context, proxy, make_request("/api/length"));
+        REQUIRE(response.ends_with("\r\n\r\nhello"));
+        REQUIRE(backend.last_request().starts_with("GET /api/length "));
+        REQUIRE(backend.connections == 1);
+    }
+
+    SECTION("Malformed Content-Length is a bad gateway") {
+        auto response =
+            forward(context, proxy, make_request("/api/bad-length"));
+        REQUIRE(response.starts_with("HTTP/1.0 502"));
+    }
+
+    SECTION("Upstream connections are kept alive and reused") {
+        forward(context, proxy, make_request("/api/length"));
+        forward(context, proxy, make_request("/api/chunked"));
+        forward(context, proxy, make_request("/api/length"));
+        REQUIRE(backend.connections == 1);
+    }
+}
+
+TEST_CASE("Proxy - exchanges in flight may outlive the handler") {
+    asio::io_context context;
+    // connections end up in its backlog, and are never answered
+    tcp::acceptor silent{context, {asio::ip::make_address("127.0.0.1"), 0}};
+    {
+        const auto port = std::to_string(silent.local_endpoint().port());
+        ProxyHandler proxy{context, {{"/api", {{"127.0.0.1", port}}}}};
+        proxy.forward(make_request("/api"), "/api", "127.0.0.1",
+                      context.get_executor(),
+                      http::ProxySink{
+                          .write = [](std::string_view,
+                                      std::function<void(bool)> done) {
+                              done(true);
+                          },
+                          .finish = [] {},
+                      });
+        context.run_for(std::chrono::milliseconds{100});
+    }
+    // the exchange still waiting for a response is destroyed along with the
+    // context, after the handler
+}
+
+TEST_CASE("Proxy - failing upstreams are ejected") {
+    // grab a free port and close it again, so connecting is refused
+    std::string port;
+    {
+        asio::io_context context;
+        tcp::acceptor acceptor{context,
+                               {asio::ip::make_address("127.0.0.1"), 0}};
+        port = std::to_string(acceptor.local_endpoint().port());
+    }
+
+    asio::io_context context;
+    ProxyHandler proxy{context, {{"/api", {{"127.0.0.1", port}}}}};
+    const auto req = make_request("/api");
+
+    for (auto i = 0; i < 3; ++i) {
+        REQUIRE(forward(context, proxy, req).starts_with("HTTP/1.0 502"));
+    }
+    REQUIRE(forward(context, proxy, req).starts_with("HTTP/1.0 503"));
+}
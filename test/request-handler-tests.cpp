@@ -0,0 +1,201 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "request.hpp"
+#include "request_handler.hpp"
+#include "response.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+using http::Request;
+using http::RequestHandler;
+using http::Response;
+
+namespace {
+
+auto header(const Response& response, std::string_view name)
+    -> std::string {
+    for (const auto& h : response.headers) {
+        if (h.name == name) {
+            return h.value;
+        }
+    }
+    return {};
+}
+
+auto make_request(std::string uri) -> Request {
+    Request req;
+    req.method = "GET";
+    req.uri = std::move(uri);
+    req.version = {1, 0};
+    return req;
+}
+
+// a fresh document root for each test case, removed again afterwards
+struct DocumentRoot {
+    fs::path path = fs::temp_directory_path() /
+                    ("http-handler-test-" + std::to_string(::getpid()));
+
+    DocumentRoot() {
+        fs::remove_all(path);
+        fs::create_directories(path / "images");
+        std::ofstream{path / "index.html"} << "<html></html>";
+        std::ofstream{path / "images" / "logo.png"} << "png";
+    }
+
+    ~DocumentRoot() { fs::remove_all(path); }
+};
+
+} // namespace
+
+TEST_CASE("Request handler - special files are refused without blocking") {
+    DocumentRoot root;
+    REQUIRE(::mkfifo((root.path / "pipe").c_str(), 0644) == 0);
+    RequestHandler handler{root.path.string()};
+
+    // opening the fifo for reading would wait for a writer
+    const auto response = handler.handle(make_request("/pipe"));
+    REQUIRE(response.status == Response::StatusCode::Forbidden);
+}
+
+TEST_CASE("Request handler - status codes") {
+    DocumentRoot root;
+    fs::create_directories(root.path / "my dir");
+    fs::create_symlink("../", root.path / "up");
+    RequestHandler handler{root.path.string()};
+
+    SECTION("Files and directory indexes") {
+        auto response = handler.handle(make_request("/index.html"));
+        REQUIRE(response.status == Response::StatusCode::Ok);
+        REQUIRE(response.body() == "<html></html>");
+
+        response = handler.handle(make_request("/?q=1"));
+        REQUIRE(response.status == Response::StatusCode::Ok);
+        REQUIRE(response.body() == "<html></html>");
+    }
+
+    SECTION("Missing files") {
+        auto status = handler.handle(make_request("/missing.html")).status;
+        REQUIRE(status == Response::StatusCode::NotFound);
+
+        status = handler.handle(make_request("/index.html/child")).status;
+        REQUIRE(status == Response::StatusCode::NotFound);
+    }
+
+    SECTION("Malformed paths") {
+        const auto status = handler.handle(make_request("/../etc")).status;
+        REQUIRE(status == Response::StatusCode::BadRequest);
+    }
+
+    SECTION("Symlinks out of the document root") {
+        const auto status = handler.handle(make_request("/up/etc")).status;
+        REQUIRE(status == Response::StatusCode::Forbidden);
+    }
+
+    SECTION("Directories redirect to themselves with a trailing slash") {
+        auto response = handler.handle(make_request("/images?q=1"));
+        REQUIRE(response.status == Response::StatusCode::MovedPermanently);
+        REQUIRE(header(response, "Location") == "/images/");
+
+        response = handler.handle(make_request("/my+dir"));
+        REQUIRE(header(response, "Location") == "/my%20dir/");
+    }
+
+    SECTION("Redirects never leave the host") {
+        const auto response = handler.handle(make_request("//images"));
+        REQUIRE(response.status == Response::StatusCode::MovedPermanently);
+        REQUIRE(header(response, "Location") == "/images/");
+    }
+}
+
+TEST_CASE("Request handler - missing paths are cached until reload") {
+    DocumentRoot root;
+    RequestHandler handler{root.path.string()};
+
+    auto status = handler.handle(make_request("/new.html")).status;
+    REQUIRE(status == Response::StatusCode::NotFound);
+
+    // still answered from the cache
+    std::ofstream{root.path / "new.html"} << "new";
+    status = handler.handle(make_request("/new.html")).status;
+    REQUIRE(status == Response::StatusCode::NotFound);
+
+    REQUIRE(handler.reload());
+    status = handler.handle(make_request("/new.html")).status;
+    REQUIRE(status == Response::StatusCode::Ok);
+}
+
+TEST_CASE("Request handler - preloaded files are shared, not copied") {
+    DocumentRoot root;
+    RequestHandler handler{root.path.string(),
+                           {.enabled = true, .preload_budget = 1 << 20}};
+
+    const auto response = handler.handle(make_request("/index.html"));
+    REQUIRE(response.status == Response::StatusCode::Ok);
+    REQUIRE(response.shared_content);
+    REQUIRE(response.content.empty());
+    REQUIRE(header(response, "Content-Length") == "13");
+
+    // the response keeps its content while a reload replaces the index
+    std::ofstream{root.path / "index.html"} << "<html>new</html>";
+    REQUIRE(handler.reload());
+    REQUIRE(response.body() == "<html></html>");
+    REQUIRE(handler.handle(make_request("/index.html")).body() ==
+            "<html>new</html>");
+}
+
+TEST_CASE("Request handler - indexed files are served with indexed headers") {
+    DocumentRoot root;
+    RequestHandler handler{root.path.string(), {.enabled = true}};
+    const auto etag = handler.document_index()->find("/index.html")->etag;
+
+    // rewrite a file with an mtime that is sure to differ from the indexed one
+    const auto rewrite = [&root](std::string_view content) {
+        const auto path = root.path / "index.html";
+        const auto modified = fs::last_write_time(path);
+        std::ofstream{path} << content;
+        fs::last_write_time(path, modified + std::chrono::hours{1});
+    };
+
+    SECTION("Unchanged files") {
+        const auto response = handler.handle(make_request("/index.html"));
+        REQUIRE(response.status == Response::StatusCode::Ok);
+        REQUIRE(header(response, "ETag") == etag);
+        REQUIRE(response.body() == "<html></html>");
+    }
+
+    SECTION("A file rewritten at the same size gets a new ETag") {
+        rewrite("<body></body>");
+
+        const auto response = handler.handle(make_request("/index.html"));
+        REQUIRE(response.status == Response::StatusCode::Ok);
+        REQUIRE(header(response, "ETag") != etag);
+        REQUIRE(response.body() == "<body></body>");
+    }
+
+    SECTION("A file that grew is served whole") {
+        rewrite("<html><body></body></html>");
+
+        const auto response = handler.handle(make_request("/index.html"));
+        REQUIRE(response.status == Response::StatusCode::Ok);
+        REQUIRE(header(response, "Content-Length") == "26");
+        REQUIRE(header(response, "ETag") != etag);
+        REQUIRE(response.body() == "<html><body></body></html>");
+    }
+
+    SECTION("A file that shrank is served whole") {
+        rewrite("<p>");
+
+        const auto response = handler.handle(make_request("/index.html"));
+        REQUIRE(response.status == Response::StatusCode::Ok);
+        REQUIRE(header(response, "Content-Length") == "3");
+        REQUIRE(response.body() == "<p>");
+    }
+}
@@ -0,0 +1,132 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "response.hpp"
+
+#include <algorithm>
+#include <asio/buffer.hpp>
+#include <memory>
+#include <string>
+
+using http::Response;
+
+namespace {
+
+// concatenate the buffers a response would be written with
+std::string gather(const Response& response) {
+    std::string out;
+    for (const auto& buffer : response.to_buffers()) {
+        out.append(static_cast<const char*>(buffer.data()), buffer.size());
+    }
+    return out;
+}
+
+} // namespace
+
+TEST_CASE("Response serialization - coalesced form matches buffers") {
+    Response response;
+    response.status = Response::StatusCode::Ok;
+    response.content = "hello";
+    response.headers.push_back({"Content-Length", "5"});
+    response.headers.push_back({"Content-Type", "text/plain"});
+
+    std::string out;
+    response.serialize_to(out);
+    REQUIRE(out == "HTTP/1.0 200 Ok\r\n"
+                   "Content-Length: 5\r\n"
+                   "Content-Type: text/plain\r\n"
+                   "\r\n"
+                   "hello");
+    REQUIRE(out == gather(response));
+    REQUIRE(response.size() == out.size());
+
+    SECTION("Appends to what is already buffered") {
+        std::string buffered = "x";
+        response.serialize_to(buffered);
+        REQUIRE(buffered == "x" + out);
+    }
+}
+
+TEST_CASE("Response serialization - shared content") {
+    Response response;
+    response.status = Response::StatusCode::Ok;
+    response.content = "ignored";
+    response.shared_content = std::make_shared<const std::string>("hello");
+    response.headers.push_back({"Content-Length", "5"});
+
+    std::string out;
+    response.serialize_to(out);
+    REQUIRE(out == "HTTP/1.0 200 Ok\r\n"
+                   "Content-Length: 5\r\n"
+                   "\r\n"
+                   "hello");
+    REQUIRE(out == gather(response));
+    REQUIRE(response.size() == out.size());
+    REQUIRE(response.body() == "hello");
+}
+
+TEST_CASE("Response serialization - stock responses") {
+    const auto response = Response::from(Response::StatusCode::NotFound);
+
+    std::string out;
+    response.serialize_to(out);
+    REQUIRE(out == response.serialized);
+    REQUIRE(out == gather(response));
+    REQUIRE(response.size() == out.size());
+}
+
+TEST_CASE("Stock responses - built once and shared") {
+    const auto first = Response::from(Response::StatusCode::NotFound);
+    const auto second = Response::from(Response::StatusCode::NotFound);
+    REQUIRE(first.serialized.data() == second.serialized.data());
+    REQUIRE(first.serialized.starts_with("HTTP/1.0 404 Not Found\r\n"));
+    REQUIRE(first.serialized.ends_with(
+        Response::stock(Response::StatusCode::NotFound).content));
+
+    SECTION("Unknown status codes get the 500 response") {
+        const auto response = Response::from(Response::StatusCode{299});
+        REQUIRE(response.status == Response::StatusCode::InternalServerError);
+    }
+
+    SECTION("Status lines") {
+        const auto line = http::to_status_line(Response::StatusCode::Ok);
+        REQUIRE(line == "HTTP/1.0 200 Ok\r\n");
+        REQUIRE(line.data() ==
+                http::to_status_line(Response::StatusCode::Ok).data());
+    }
+}
+
+TEST_CASE("Response serialization - Date is written by reference") {
+    Response response;
+    response.status = Response::StatusCode::Ok;
+    response.headers.push_back({"Content-Length", "0"});
+    response.date = http::http_date();
+
+    std::string out;
+    response.serialize_to(out);
+    REQUIRE(out == "HTTP/1.0 200 Ok\r\n"
+                   "Content-Length: 0\r\n"
+                   "Date: " + *response.date + "\r\n"
+                   "\r\n");
+    REQUIRE(out == gather(response));
+    REQUIRE(response.size() == out.size());
+
+    const auto buffers = response.to_buffers();
+    REQUIRE(std::ranges::any_of(buffers, [&](const auto& buffer) {
+        return buffer.data() == response.date->data();
+    }));
+}
+
+TEST_CASE("Date cache - formatted at most once a second") {
+    auto first = http::http_date();
+    auto second = http::http_date();
+    if (first != second) { // the second just ticked over
+        first = second;
+        second = http::http_date();
+    }
+    REQUIRE(first == second);
+
+    // IMF-fixdate, e.g "Sun, 06 Nov 1994 08:49:37 GMT"
+    REQUIRE(first->size() == 29);
+    REQUIRE(first->ends_with(" GMT"));
+}
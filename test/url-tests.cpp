@@ -0,0 +1,84 @@
+#define CATCH_CONFIG_MAIN
+#include <catch2/catch.hpp>
+
+#include "request_handler.hpp"
+
+#include <string>
+
+using http::decode_url;
+
+TEST_CASE("URL decoding - escapes") {
+    std::string out;
+
+    REQUIRE(decode_url("/index.html", out));
+    REQUIRE(out == "/index.html");
+
+    REQUIRE(decode_url("/hello%20world+again", out));
+    REQUIRE(out == "/hello world again");
+
+    SECTION("Zero nibbles are valid") {
+        REQUIRE(decode_url("/%30%0A", out));
+        REQUIRE(out == "/0\n");
+    }
+
+    SECTION("Malformed escapes are rejected") {
+        REQUIRE_FALSE(decode_url("/%", out));
+        REQUIRE_FALSE(decode_url("/%4", out));
+        REQUIRE_FALSE(decode_url("/%zz", out));
+        REQUIRE_FALSE(decode_url("/%-1", out));
+    }
+
+    SECTION("NUL bytes are rejected") {
+        REQUIRE_FALSE(decode_url("/index.html%00.png", out));
+        REQUIRE_FALSE(
+            decode_url(std::string_view{"/index.html\0.png", 16}, out));
+    }
+}
+
+TEST_CASE("URL decoding - path normalization") {
+    std::string out;
+
+    SECTION("Relative paths are rejected") {
+        REQUIRE_FALSE(decode_url("", out));
+        REQUIRE_FALSE(decode_url("index.html", out));
+    }
+
+    SECTION("Empty and dot segments collapse") {
+        REQUIRE(decode_url("//a///b/./c/.", out));
+        REQUIRE(out == "/a/b/c/");
+
+        REQUIRE(decode_url("/./", out));
+        REQUIRE(out == "/");
+    }
+
+    SECTION("Dot-dot segments are rejected") {
+        REQUIRE_FALSE(decode_url("/..", out));
+        REQUIRE_FALSE(decode_url("/a/../b", out));
+        REQUIRE_FALSE(decode_url("/a/%2e%2E/b", out));
+        REQUIRE_FALSE(decode_url("/a%2f..%2fb", out));
+    }
+
+    SECTION("Dots inside a segment are allowed") {
+        REQUIRE(decode_url("/a..b/...", out));
+        REQUIRE(out == "/a..b/...");
+    }
+
+    SECTION("Query string is dropped") {
+        REQUIRE(decode_url("/search?q=..", out));
+        REQUIRE(out == "/search");
+    }
+}
+
+TEST_CASE("URL encoding - decodes back to the same path") {
+    using http::encode_url;
+
+    REQUIRE(encode_url("/images/logo.png") == "/images/logo.png");
+    REQUIRE(encode_url("/a b+c?%") == "/a%20b%2Bc%3F%25");
+    REQUIRE(encode_url("/caf\xc3\xa9") == "/caf%C3%A9");
+
+    std::string out;
+    for (const auto path : {"/a b+c?%#/", "/\x01\x7f\xff", "/~user/it's"}) {
+        REQUIRE(decode_url(encode_url(path), out));
+        REQUIRE(out == path);
+    }
+}